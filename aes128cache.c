@@ -0,0 +1,208 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "aes128cache.h"
+#include "aes128common.h"
+
+/* An entry of the cache: the key bytes its expanded key was expanded from */
+struct cacheEntry {
+    unsigned char k[16];
+    uint64_t used;
+    int valid;
+};
+
+/* Entries of one kind of a thread, with their expanded keys of size bytes each at keys (NULL until the
+   first lookup of the kind) */
+struct kindTable {
+    struct cacheEntry e[AES128_CACHE_SIZE];
+    unsigned char *keys;
+    size_t size;
+};
+
+/* Cache of a thread, linked in the list of the caches of every thread so that aes128_cache_wipe() reaches
+   it. lock is held by the thread while it uses an entry, and by aes128_cache_wipe() while it clears them. */
+struct keyCache {
+    pthread_mutex_t lock;
+    struct kindTable t[AES128_CACHE_KINDS];
+    uint64_t clock;
+    unsigned long long hits;
+    unsigned long long misses;
+    struct keyCache *prev;
+    struct keyCache *next;
+};
+
+/* Cache of the calling thread, allocated at its first lookup */
+static __thread struct keyCache *mine;
+
+/* Set by aes128_cache_enable() or the environment */
+static int enabled;
+
+/* The caches of every live thread */
+static struct keyCache *caches;
+static pthread_mutex_t cachesLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Its destructor frees the cache of a thread when the thread exits */
+static pthread_key_t exitKey;
+
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+
+/* Clears every entry of the cache c */
+static void wipeCache(struct keyCache *c) {
+
+    int i;
+    for (i = 0; i < AES128_CACHE_KINDS; ++i) {
+        struct kindTable *t = &c->t[i];
+        if (t->keys != NULL) wipe(t->keys, 0, AES128_CACHE_SIZE*t->size);
+        wipe(t->e, 0, sizeof t->e);
+    }
+}
+
+/* Removes the cache of an exiting thread from the list, clears it and frees it */
+static void freeCache(void *arg) {
+
+    struct keyCache *c = arg;
+
+    pthread_mutex_lock(&cachesLock);
+    if (c->prev != NULL) c->prev->next = c->next;
+    else caches = c->next;
+    if (c->next != NULL) c->next->prev = c->prev;
+    pthread_mutex_unlock(&cachesLock);
+
+    wipeCache(c);
+    int i;
+    for (i = 0; i < AES128_CACHE_KINDS; ++i) {
+        free(c->t[i].keys);
+    }
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+/* Reads AES128_KEY_CACHE from the environment, and creates the key of the exit destructor */
+static void init(void) {
+
+    const char *env = getenv("AES128_KEY_CACHE");
+    if (env != NULL && strcmp(env, "1") == 0) __atomic_store_n(&enabled, 1, __ATOMIC_RELAXED);
+    pthread_key_create(&exitKey, freeCache);
+}
+
+/* Returns the cache of the calling thread, allocating it and adding it to the list at the first call, or NULL
+   if it cannot be allocated */
+static struct keyCache *ownCache(void) {
+
+    if (mine != NULL) return mine;
+
+    struct keyCache *c = calloc(1, sizeof *c);
+    if (c == NULL) return NULL;
+    pthread_mutex_init(&c->lock, NULL);
+
+    pthread_mutex_lock(&cachesLock);
+    c->next = caches;
+    if (caches != NULL) caches->prev = c;
+    caches = c;
+    pthread_mutex_unlock(&cachesLock);
+
+    pthread_setspecific(exitKey, c);
+    mine = c;
+    return c;
+}
+
+/* Returns 0 if the 16-byte keys at x and y are equal, in time independent of their contents */
+static int keyCompare(const unsigned char *x, const unsigned char *y) {
+
+    unsigned char d = 0;
+    int i;
+    for (i = 0; i < 16; ++i) {
+        d |= x[i] ^ y[i];
+    }
+    return d;
+}
+
+/* Enable (on != 0) or disable the cache for every thread. */
+void aes128_cache_enable(int on) {
+
+    pthread_once(&initOnce, init);
+    __atomic_store_n(&enabled, on != 0, __ATOMIC_RELAXED);
+}
+
+/* Returns the expanded key of the given kind for the 16-byte key at k from the cache of the calling thread,
+   expanding it into the least recently used entry on a miss. The cache of the thread is held until
+   aes128_cache_release(). Returns NULL if the cache is disabled or cannot be allocated. */
+void *aes128_cache_acquire(const aes128_cache_kind *kind, const unsigned char *k) {
+
+    pthread_once(&initOnce, init);
+    if (!__atomic_load_n(&enabled, __ATOMIC_RELAXED)) return NULL;
+
+    struct keyCache *c = ownCache();
+    if (c == NULL) return NULL;
+
+    pthread_mutex_lock(&c->lock);
+
+    /* The entries of a kind are only allocated once the thread uses it */
+    struct kindTable *t = &c->t[kind->id];
+    if (t->keys == NULL) {
+        t->keys = malloc(AES128_CACHE_SIZE*kind->size);
+        if (t->keys == NULL) {
+            pthread_mutex_unlock(&c->lock);
+            return NULL;
+        }
+        t->size = kind->size;
+    }
+
+    /* Every entry is compared, so the time does not depend on which one holds the key */
+    int found = -1;
+    int lru = 0;
+    int i;
+    for (i = 0; i < AES128_CACHE_SIZE; ++i) {
+        if (t->e[i].valid && keyCompare(t->e[i].k, k) == 0) found = i;
+        if (!t->e[i].valid || (t->e[lru].valid && t->e[i].used < t->e[lru].used)) lru = i;
+    }
+
+    struct cacheEntry *e;
+    unsigned char *key;
+    if (found >= 0) {
+        e = &t->e[found];
+        key = t->keys + found*t->size;
+        ++c->hits;
+    }
+    else {
+        e = &t->e[lru];
+        key = t->keys + lru*t->size;
+        wipe(key, 0, t->size);
+        memcpy(e->k, k, 16);
+        kind->expand(key, k);
+        e->valid = 1;
+        ++c->misses;
+    }
+    e->used = ++c->clock;
+    return key;
+}
+
+/* Release the cache of the calling thread after a successful aes128_cache_acquire(). */
+void aes128_cache_release(void) {
+
+    pthread_mutex_unlock(&mine->lock);
+}
+
+/* Store at hits and misses the number of lookups of the calling thread found and not found in its cache. */
+void aes128_cache_stats(unsigned long long *hits, unsigned long long *misses) {
+
+    *hits = mine != NULL ? mine->hits : 0;
+    *misses = mine != NULL ? mine->misses : 0;
+}
+
+/* Clear the cached keys of every thread: each cache in the list is cleared under its lock, after the call
+   of its thread that is using an entry, if any, has finished. */
+void aes128_cache_wipe(void) {
+
+    pthread_once(&initOnce, init);
+
+    pthread_mutex_lock(&cachesLock);
+    struct keyCache *c;
+    for (c = caches; c != NULL; c = c->next) {
+        pthread_mutex_lock(&c->lock);
+        wipeCache(c);
+        pthread_mutex_unlock(&c->lock);
+    }
+    pthread_mutex_unlock(&cachesLock);
+}
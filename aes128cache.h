@@ -0,0 +1,53 @@
+#ifndef AES128CACHE_H
+#define AES128CACHE_H
+
+#include <stddef.h>
+
+/* Number of expanded keys of each kind kept by each thread */
+#define AES128_CACHE_SIZE 8
+
+/* Opt-in cache of expanded keys for the functions that take the raw 16 key bytes (aes128e(), aes128d(),
+   aes128ocb(), aes128ocb_encrypt() and aes128ocb_decrypt()). Each thread keeps its AES128_CACHE_SIZE most
+   recently used keys of each kind, so hot keys skip the key expansion: AES key schedules for aes128e(),
+   decryption key schedules for aes128d() and full OCB keys for the OCB functions. A thread only holds a
+   pointer until it first looks a key up with the cache enabled; the entries of a kind are allocated at its
+   first lookup and freed when the thread exits. Disabled by default; enabled by aes128_cache_enable(1) or by
+   the AES128_KEY_CACHE=1 environment variable. */
+
+/* Kinds of expanded keys, each with its own entries */
+enum {
+    AES128_CACHE_ENC = 0,       /* aes128_key, in aes128e.c */
+    AES128_CACHE_DEC,           /* aes128_dkey, in aes128d.c */
+    AES128_CACHE_OCB,           /* aes128ocb_key, in aes128ocb.c */
+    AES128_CACHE_KINDS
+};
+
+/* A kind of expanded key: its AES128_CACHE_* number, its size in bytes, and the function that expands the
+   16-byte key at k into the entry at key */
+typedef struct {
+    int id;
+    size_t size;
+    void (*expand)(void *key, const unsigned char *k);
+} aes128_cache_kind;
+
+/* Enable (on != 0) or disable the cache for every thread. */
+void aes128_cache_enable(int on);
+
+/* Returns the expanded key of the given kind for the 16-byte key at k from the cache of the calling thread,
+   expanding it into the least recently used entry on a miss. The cache of the thread is then held, so that
+   aes128_cache_wipe() cannot clear the entry while it is in use, until aes128_cache_release(); the caller must
+   not look up another key before that. Until then the entry belongs to the caller, which may update state kept
+   with the key (the nonce memo of OCB). Returns NULL, with nothing to release, if the cache is disabled or its
+   entries cannot be allocated. */
+void *aes128_cache_acquire(const aes128_cache_kind *kind, const unsigned char *k);
+
+/* Release the cache of the calling thread after a successful aes128_cache_acquire(). */
+void aes128_cache_release(void);
+
+/* Store at hits and misses the number of lookups of the calling thread found and not found in its cache. */
+void aes128_cache_stats(unsigned long long *hits, unsigned long long *misses);
+
+/* Clear the cached keys of every thread, for a key rotation. Waits for the keys other threads are using. */
+void aes128_cache_wipe(void);
+
+#endif
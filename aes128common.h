@@ -0,0 +1,30 @@
+#ifndef AES128COMMON_H
+#define AES128COMMON_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* Definitions shared by the block cipher in aes128e.c, the inverse cipher in aes128d.c and the files built
+   on them. Internal to the library: not included by the public headers. */
+
+/* The AES-NI backend is compiled in on x86 with GCC or Clang unless AES128E_NO_AESNI is defined */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(AES128E_NO_AESNI)
+#define AES128E_AESNI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
+/* Big-endian load and store of a 32-bit word (a column of the state) */
+#define GETU32(b) (((uint32_t)(b)[0] << 24) | ((uint32_t)(b)[1] << 16) | ((uint32_t)(b)[2] << 8) | (uint32_t)(b)[3])
+#define PUTU32(b, w) do { (b)[0] = (unsigned char)((w) >> 24); (b)[1] = (unsigned char)((w) >> 16); \
+                          (b)[2] = (unsigned char)((w) >> 8); (b)[3] = (unsigned char)(w); } while (0)
+
+/* Multiplication by two in GF(2^8) without a branch, so it runs in constant time on key material.
+   Multiplication by three is xtime(a) ^ a */
+#define xtime(a) ((unsigned char)(((a) << 1) ^ (0x1b & -((a) >> 7))))
+
+/* memset called through a volatile pointer, so that clearing key material or keystream that is not read
+   again is not removed by the compiler */
+static void *(*const volatile wipe)(void *, int, size_t) = memset;
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdint.h>
+#include <string.h>
+#include "aes128ctr.h"
+#include "aes128e.h"
+#include "aes128common.h"
+
+/* Number of counter blocks encrypted per call to the block cipher: enough for two rounds of the 8-way
+   AES-NI loop or of the 16-block bitsliced kernel */
+#define CTR_WIDE 32
+
+/* Read the 64-bit big-endian integer at x */
+static uint64_t load64(const unsigned char *x) {
+
+    uint64_t v = 0;
+    int i;
+    for (i = 0; i < 8; ++i) {
+        v = (v << 8) | x[i];
+    }
+    return v;
+}
+
+/* Write v at x as a 64-bit big-endian integer */
+static void store64(unsigned char *x, uint64_t v) {
+
+    int i;
+    for (i = 7; i >= 0; --i) {
+        x[i] = (unsigned char)v;
+        v >>= 8;
+    }
+}
+
+/* Add v to the 128-bit big-endian counter at ctr */
+static void addCounter(unsigned char *ctr, uint64_t v) {
+
+    uint64_t lo = load64(ctr + 8) + v;
+    if (lo < v) store64(ctr, load64(ctr) + 1);
+    store64(ctr + 8, lo);
+}
+
+/* Xor of the len bytes at x and y stored at z, a 64-bit word at a time */
+static void xorBytes(unsigned char *z, const unsigned char *x, const unsigned char *y, size_t len) {
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, x + i, 8);
+        memcpy(&b, y + i, 8);
+        a ^= b;
+        memcpy(z + i, &a, 8);
+    }
+    for (; i < len; ++i) {
+        z[i] = x[i] ^ y[i];
+    }
+}
+
+/* Compute at out the keystream of nblocks blocks starting at the counter block ctr, and advance ctr past them */
+static void keystream(unsigned char *out, unsigned char *ctr, size_t nblocks, const aes128ctr_ctx *ctx) {
+
+    uint64_t hi = load64(ctr);
+    uint64_t lo = load64(ctr + 8);
+    size_t b;
+    for (b = 0; b < nblocks; ++b) {
+        store64(out + 16*b, hi);
+        store64(out + 16*b + 8, lo);
+        if (++lo == 0) ++hi;
+    }
+    store64(ctr, hi);
+    store64(ctr + 8, lo);
+    aes128e_blocks_sk(out, out, nblocks, &ctx->ks, &ctx->sk);
+}
+
+/* Start a context under the 16-byte key at k. */
+void aes128ctr_init(aes128ctr_ctx *ctx, const unsigned char *k) {
+
+    aes128_expand_key(&ctx->ks, k);
+    aes128_slice_key(&ctx->sk, &ctx->ks);
+    memset(ctx->iv, 0, 16);
+    ctx->pre = NULL;
+    ctx->prelen = 0;
+}
+
+/* Compute at buf the first len bytes of keystream for the 16-byte iv at iv, rounded down to whole blocks, for the
+   next aes128ctr_xor() with the same iv. */
+void aes128ctr_precompute(aes128ctr_ctx *ctx, const unsigned char *iv, unsigned char *buf, size_t len) {
+
+    unsigned char ctr[16];
+    memcpy(ctr, iv, 16);
+
+    if (ctx->pre != NULL) wipe(ctx->pre, 0, ctx->prelen);
+
+    size_t nblocks = len/16;
+    keystream(buf, ctr, nblocks, ctx);
+
+    memcpy(ctx->iv, iv, 16);
+    ctx->pre = buf;
+    ctx->prelen = 16*nblocks;
+}
+
+/* Xor the len bytes at in with the keystream for the 16-byte iv at iv and store them at out. */
+void aes128ctr_xor(aes128ctr_ctx *ctx, const unsigned char *iv, const unsigned char *in, unsigned char *out, size_t len) {
+
+    unsigned char ctr[16];
+    unsigned char stream[CTR_WIDE*16];
+
+    memcpy(ctr, iv, 16);
+
+    /* A keystream precomputed for this iv is used once, then cleared */
+    if (ctx->pre != NULL && memcmp(ctx->iv, iv, 16) == 0) {
+        size_t n = len < ctx->prelen ? len : ctx->prelen;
+        xorBytes(out, in, ctx->pre, n);
+        wipe(ctx->pre, 0, ctx->prelen);
+        ctx->pre = NULL;
+        ctx->prelen = 0;
+
+        addCounter(ctr, n/16);
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    /* There is no chaining, so every iteration encrypts CTR_WIDE independent counter blocks together */
+    while (len > 0) {
+        size_t n = len < sizeof stream ? len : sizeof stream;
+        keystream(stream, ctr, (n + 15)/16, ctx);
+        xorBytes(out, in, stream, n);
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    wipe(stream, 0, sizeof stream);
+}
+
+/* Clear the key material and any unused precomputed keystream of ctx. */
+void aes128ctr_wipe(aes128ctr_ctx *ctx) {
+
+    if (ctx->pre != NULL) wipe(ctx->pre, 0, ctx->prelen);
+    wipe(ctx, 0, sizeof *ctx);
+}
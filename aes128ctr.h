@@ -0,0 +1,32 @@
+#ifndef AES128CTR_H
+#define AES128CTR_H
+
+#include <stddef.h>
+#include "aes128e.h"
+
+/* AES-128 in counter mode (NIST SP 800-38A). The counter block is the 16-byte iv, incremented as a 128-bit
+   big-endian integer for every block of keystream. A keystream for an iv can be computed in advance with
+   aes128ctr_precompute(); the next aes128ctr_xor() with that iv then only has to xor it. */
+typedef struct {
+    aes128_key ks;
+    aes128_sliced_key sk;
+    unsigned char iv[16];
+    unsigned char *pre;
+    size_t prelen;
+} aes128ctr_ctx;
+
+/* Start a context under the 16-byte (128-bit) key at k. */
+void aes128ctr_init(aes128ctr_ctx *ctx, const unsigned char *k);
+
+/* Compute at buf the first len bytes of keystream for the 16-byte iv at iv, rounded down to whole blocks, for the
+   next aes128ctr_xor() with the same iv. buf belongs to ctx until then, and is cleared when it has been used. */
+void aes128ctr_precompute(aes128ctr_ctx *ctx, const unsigned char *iv, unsigned char *buf, size_t len);
+
+/* Xor the len bytes at in with the keystream for the 16-byte iv at iv and store them at out. len is any number of
+   bytes, and out may equal in. Encryption and decryption are the same operation. */
+void aes128ctr_xor(aes128ctr_ctx *ctx, const unsigned char *iv, const unsigned char *in, unsigned char *out, size_t len);
+
+/* Clear the key material and any unused precomputed keystream of ctx. */
+void aes128ctr_wipe(aes128ctr_ctx *ctx);
+
+#endif
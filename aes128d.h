@@ -0,0 +1,35 @@
+#ifndef AES128D_H
+#define AES128D_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "aes128e.h"
+
+/* Expanded AES-128 decryption key: the round keys of the equivalent inverse cipher in the order they
+   are used, that is the encryption round keys reversed with InvMixColumns applied to rounds 1 to 9.
+   Computed once per key from the encryption key schedule by aes128_expand_dkey(). */
+typedef struct {
+    unsigned char rk[176];
+} aes128_dkey;
+
+/* Compute the decryption key schedule at dk from the encryption key schedule at ks. */
+void aes128_expand_dkey(aes128_dkey *dk, const aes128_key *ks);
+
+/* Under the decryption key at dk, decrypt the 16-byte ciphertext at c and store it at p. */
+void aes128d_ks(unsigned char *p, const unsigned char *c, const aes128_dkey *dk);
+
+/* Under the decryption key at dk, decrypt the nblocks 16-byte blocks at in and store them at out.
+   in may equal out. */
+void aes128d_blocks(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_dkey *dk);
+
+/* Slice the decryption key schedule at dk into sk if the bitsliced backend is selected. */
+void aes128_slice_dkey(aes128_sliced_key *sk, const aes128_dkey *dk);
+
+/* Same as aes128d_blocks(), with the round keys sliced at sk by aes128_slice_dkey() from the same dk. */
+void aes128d_blocks_sk(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_dkey *dk,
+                       const aes128_sliced_key *sk);
+
+/* Under the 16-byte key at k, decrypt the 16-byte ciphertext at c and store it at p. */
+void aes128d(unsigned char *p, const unsigned char *c, const unsigned char *k);
+
+#endif
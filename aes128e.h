@@ -1,3 +1,63 @@
+#ifndef AES128E_H
+#define AES128E_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Expanded AES-128 key. The key schedule of Nb*(Nr + 1) = 176 bytes is computed once per key by
+   aes128_expand_key() and can then be used for any number of block encryptions. */
+typedef struct {
+    unsigned char rk[176];
+} aes128_key;
+
+/* Round keys of a key schedule sliced for the bitsliced backend by aes128_slice_key() or aes128_slice_dkey(),
+   kept by the caller next to the schedule so that aes128e_blocks_sk() and aes128d_blocks_sk() do not slice
+   them again for every call. sliced is 0 if another backend was selected when the key was sliced. */
+typedef struct {
+    uint64_t sk[88];
+    int sliced;
+} aes128_sliced_key;
+
+/* Implementations of the block cipher. The best one supported by the CPU is chosen at first use; the
+   AES128_BACKEND environment variable ("ref", "ttable", "aesni" or "bitslice") or aes128_set_backend()
+   force one. */
+enum {
+    AES128_BACKEND_AUTO = 0,    /* AES-NI if the CPU supports it, the 32-bit implementation otherwise */
+    AES128_BACKEND_REF,         /* Byte-matrix reference implementation */
+    AES128_BACKEND_TTABLE,      /* 32-bit implementation with fused round tables */
+    AES128_BACKEND_AESNI,       /* AESENC/AESENCLAST instructions (x86 only) */
+    AES128_BACKEND_BITSLICE,    /* Constant-time bitsliced implementation, 8 or 16 blocks at a time */
+    AES128_NUM_BACKENDS
+};
+
+/* Force the backend b. Must not be called while other threads are encrypting. Returns 0 on success
+   and -1 if b is not compiled in or not supported by the CPU. */
+int aes128_set_backend(int b);
+
+/* Returns the AES128_BACKEND_* constant of the backend in use. */
+int aes128_get_backend(void);
+
+/* Returns the name of the backend b. */
+const char *aes128_backend_name(int b);
+
+/* Expand the 16-byte key at k into the key schedule at ks. */
+void aes128_expand_key(aes128_key *ks, const unsigned char *k);
+
+/* Under the expanded key at ks, encrypt the 16-byte plaintext at p and store it at c. */
+void aes128e_ks(unsigned char *c, const unsigned char *p, const aes128_key *ks);
+
+/* Under the expanded key at ks, encrypt the nblocks 16-byte blocks at in and store them at out. The
+   blocks are independent (ECB), so backends can process several of them at once. in may equal out. */
+void aes128e_blocks(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_key *ks);
+
+/* Slice the key schedule at ks into sk if the bitsliced backend is selected. */
+void aes128_slice_key(aes128_sliced_key *sk, const aes128_key *ks);
+
+/* Same as aes128e_blocks(), with the round keys sliced at sk by aes128_slice_key() from the same ks. */
+void aes128e_blocks_sk(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_key *ks,
+                       const aes128_sliced_key *sk);
+
 /* Under the 16-byte key at k, encrypt the 16-byte plaintext at p and store it at c. */
 void aes128e(unsigned char *c, const unsigned char *p, const unsigned char *k);
 
+#endif
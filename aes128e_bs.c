@@ -0,0 +1,240 @@
+#include <stdint.h>
+#include <string.h>
+#include "aes128e.h"
+#include "aes128d.h"
+#include "aes128e_bs.h"
+#include "aes128common.h"
+
+/* Bitsliced AES-128 in the style of Käsper and Schwabe. The state of four blocks is held in eight
+   64-bit words, word i containing bit i of every byte, so SubBytes becomes a boolean circuit and
+   ShiftRows and MixColumns become shifts and rotations. No table lookup depends on the key or on the
+   data, which makes the code immune to cache-timing attacks. Wider words (SSE2 and AVX2 vectors of
+   64-bit lanes) run the same code on 8 or 16 blocks at once. */
+
+/* The round constant table (needed in KeyExpansion) */
+static const unsigned char rcon[10] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 
+    0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+/* Little-endian load of a 32-bit word */
+static uint64_t load32(const unsigned char *b) {
+    return (uint64_t)b[0] | ((uint64_t)b[1] << 8) | ((uint64_t)b[2] << 16) | ((uint64_t)b[3] << 24);
+}
+
+/* Spread the four bytes of x to the even bytes of a 64-bit word */
+static uint64_t spread(uint64_t x) {
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    return x;
+}
+
+/* Gather the even bytes of the 64-bit word x into the low four bytes */
+static uint64_t unspread(uint64_t x) {
+    x &= 0x00FF00FF00FF00FFULL;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFULL;
+    return x;
+}
+
+/* Word for half h of the 16-byte block at b: columns h and h + 2 interleaved byte by byte */
+static uint64_t packWord(const unsigned char *b, int h) {
+    return spread(load32(b + 4*h)) | (spread(load32(b + 8 + 4*h)) << 8);
+}
+
+/* Store the word w of half h back to columns h and h + 2 of the 16-byte block at b */
+static void unpackWord(unsigned char *b, int h, uint64_t w) {
+
+    uint64_t lo = unspread(w);
+    uint64_t hi = unspread(w >> 8);
+    int i;
+    for (i = 0; i < 4; ++i) {
+        b[4*h + i] = (unsigned char)(lo >> (8*i));
+        b[8 + 4*h + i] = (unsigned char)(hi >> (8*i));
+    }
+}
+
+/* Portable width: one 64-bit word per bit plane, 4 blocks */
+#define BS_WORD uint64_t
+#define BS_LANES 1
+#define BS_NAME(f) f##X4
+#define BS_ATTR
+#include "aes128e_bs.inc"
+#undef BS_ATTR
+#undef BS_NAME
+#undef BS_LANES
+#undef BS_WORD
+
+#ifdef __GNUC__
+
+/* SSE2 width (or the equivalent on other targets): two 64-bit lanes per bit plane, 8 blocks */
+typedef uint64_t bs_v2 __attribute__((vector_size(16)));
+
+#define BS_WORD bs_v2
+#define BS_LANES 2
+#define BS_NAME(f) f##X8
+#define BS_ATTR
+#include "aes128e_bs.inc"
+#undef BS_ATTR
+#undef BS_NAME
+#undef BS_LANES
+#undef BS_WORD
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* AVX2 width: four 64-bit lanes per bit plane, 16 blocks. Selected at run time */
+typedef uint64_t bs_v4 __attribute__((vector_size(32)));
+
+#define BS_WORD bs_v4
+#define BS_LANES 4
+#define BS_NAME(f) f##X16
+#define BS_ATTR __attribute__((target("avx2")))
+#include "aes128e_bs.inc"
+#undef BS_ATTR
+#undef BS_NAME
+#undef BS_LANES
+#undef BS_WORD
+
+#define AES128E_BS_AVX2
+
+#endif
+#endif
+
+/* Bitsliced round key: the 16-byte round key at rk repeated for the four blocks of a word */
+static void sliceRoundKey(uint64_t *sk, const unsigned char *rk) {
+
+    uint64_t w0 = packWord(rk, 0);
+    uint64_t w1 = packWord(rk, 1);
+    int i;
+    for (i = 0; i < 4; ++i) {
+        sk[i] = w0;
+        sk[i + 4] = w1;
+    }
+    orthoX4(sk);
+}
+
+/* SubWord of the key expansion with the bitsliced S-box, so the key schedule runs in constant time */
+static void subWord(unsigned char *w) {
+
+    uint64_t q[8];
+    unsigned char b[16];
+    int i;
+
+    memset(b, 0, 16);
+    memcpy(b, w, 4);
+    for (i = 0; i < 8; ++i) {
+        q[i] = packWord(b, i >> 2);
+    }
+    orthoX4(q);
+    subBytesX4(q);
+    orthoX4(q);
+    unpackWord(b, 0, q[0]);
+    memcpy(w, b, 4);
+    wipe(q, 0, sizeof q);
+    wipe(b, 0, sizeof b);
+}
+
+/* Constant-time key expansion: the S-box of the key schedule is computed with the bitsliced circuit. */
+void aes128_expand_key_bs(aes128_key *ks, const unsigned char *k) {
+
+    unsigned char temp[4], c;
+    int i, cont;
+
+    /* Same key schedule as keyExpansion() in aes128e.c */
+    memcpy(ks->rk, k, 16);
+    for (cont = 16; cont < 176; cont += 4) {
+        memcpy(temp, ks->rk + cont - 4, 4);
+        if (cont%16 == 0) {
+            c = temp[0];
+            temp[0] = temp[1];
+            temp[1] = temp[2];
+            temp[2] = temp[3];
+            temp[3] = c;
+            subWord(temp);
+            temp[0] ^= rcon[cont/16 - 1];
+        }
+        for (i = 0; i < 4; ++i) {
+            ks->rk[cont + i] = ks->rk[cont + i - 16] ^ temp[i];
+        }
+    }
+    wipe(temp, 0, sizeof temp);
+}
+
+/* Slice the 11 round keys of the 176-byte key schedule at rk into the 88 words at sk. */
+void aes128_slice_bs(uint64_t *sk, const unsigned char *rk) {
+
+    int i;
+    for (i = 0; i < 11; ++i) {
+        sliceRoundKey(sk + 8*i, rk + 16*i);
+    }
+}
+
+/* Run the encryption (dec = 0) or decryption (dec = 1) kernel over nblocks blocks with the sliced round keys
+   at sk. 16 blocks at a time with AVX2 when there are more than 8 blocks left, otherwise 8 or 4 at a time */
+static void runSliced(unsigned char *out, const unsigned char *in, size_t nblocks, const uint64_t *sk, int dec) {
+
+#ifdef AES128E_BS_AVX2
+    if (nblocks > 8 && __builtin_cpu_supports("avx2")) {
+        while (nblocks > 8) {
+            size_t n = nblocks < 16 ? nblocks : 16;
+            if (dec) decryptX16(out, in, n, sk);
+            else encryptX16(out, in, n, sk);
+            in += 16*n;
+            out += 16*n;
+            nblocks -= n;
+        }
+    }
+#endif
+
+    while (nblocks > 0) {
+#ifdef __GNUC__
+        size_t n = nblocks < 8 ? nblocks : 8;
+        if (n > 4) {
+            if (dec) decryptX8(out, in, n, sk);
+            else encryptX8(out, in, n, sk);
+        }
+        else {
+            if (dec) decryptX4(out, in, n, sk);
+            else encryptX4(out, in, n, sk);
+        }
+#else
+        size_t n = nblocks < 4 ? nblocks : 4;
+        if (dec) decryptX4(out, in, n, sk);
+        else encryptX4(out, in, n, sk);
+#endif
+        in += 16*n;
+        out += 16*n;
+        nblocks -= n;
+    }
+}
+
+/* Run the kernel with the 11 round keys at rk, sliced on the stack for this call and cleared afterwards */
+static void runBlocks(unsigned char *out, const unsigned char *in, size_t nblocks, const unsigned char *rk, int dec) {
+
+    uint64_t sk[88];
+    aes128_slice_bs(sk, rk);
+    runSliced(out, in, nblocks, sk, dec);
+    wipe(sk, 0, sizeof sk);
+}
+
+/* Under the expanded key at ks, encrypt the nblocks 16-byte blocks at in and store them at out with
+   the bitsliced implementation. The blocks are processed 8 (SSE2) or 16 (AVX2) at a time. The round keys
+   are sliced for each call on the stack, so the key schedule stays the same for every backend. */
+void aes128e_blocks_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_key *ks) {
+    runBlocks(out, in, nblocks, ks->rk, 0);
+}
+
+/* Under the decryption key at dk, decrypt the nblocks 16-byte blocks at in and store them at out with
+   the bitsliced implementation. */
+void aes128d_blocks_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_dkey *dk) {
+    runBlocks(out, in, nblocks, dk->rk, 1);
+}
+
+/* Encrypt the nblocks 16-byte blocks at in with the round keys sliced at sk by aes128_slice_bs(). */
+void aes128e_blocks_sliced_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const uint64_t *sk) {
+    runSliced(out, in, nblocks, sk, 0);
+}
+
+/* Decrypt the nblocks 16-byte blocks at in with the decryption round keys sliced at sk by aes128_slice_bs(). */
+void aes128d_blocks_sliced_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const uint64_t *sk) {
+    runSliced(out, in, nblocks, sk, 1);
+}
@@ -0,0 +1,29 @@
+#ifndef AES128E_BS_H
+#define AES128E_BS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "aes128e.h"
+#include "aes128d.h"
+
+/* Constant-time key expansion: the S-box of the key schedule is computed with the bitsliced circuit. */
+void aes128_expand_key_bs(aes128_key *ks, const unsigned char *k);
+
+/* Under the expanded key at ks, encrypt the nblocks 16-byte blocks at in and store them at out with
+   the bitsliced implementation. The blocks are processed 8 (SSE2) or 16 (AVX2) at a time. The round keys
+   are sliced for each call on the stack, so the key schedule stays the same for every backend. */
+void aes128e_blocks_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_key *ks);
+
+/* Under the decryption key at dk, decrypt the nblocks 16-byte blocks at in and store them at out with
+   the bitsliced implementation. */
+void aes128d_blocks_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128_dkey *dk);
+
+/* Slice the 11 round keys of the 176-byte key schedule at rk (encryption or decryption) into the 88 words at
+   sk, for the calls below, which do not slice them again. */
+void aes128_slice_bs(uint64_t *sk, const unsigned char *rk);
+
+/* Encrypt or decrypt the nblocks 16-byte blocks at in with the round keys sliced at sk. */
+void aes128e_blocks_sliced_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const uint64_t *sk);
+void aes128d_blocks_sliced_bs(unsigned char *out, const unsigned char *in, size_t nblocks, const uint64_t *sk);
+
+#endif
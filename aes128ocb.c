@@ -1,222 +1,1081 @@
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "aes128ocb.h"
+#include "aes128cache.h"
 #include "aes128e.h"
+#include "aes128d.h"
+#include "aes128common.h"
+#include "cryptofn_stats.h"
+
+/* Number of blocks encrypted together in the main loop: two batches of eight for AES-NI, one batch of
+   sixteen for the AVX2 bitsliced kernel */
+#define OCB_WIDE 16
+
+/* Messages shorter than this many blocks per thread are not worth splitting in aes128ocb_parallel() */
+#define OCB_PAR_MIN 4096
 
 /* Returns the exponent of the msb of 'value' */
-static unsigned int msb(unsigned int value);
+static unsigned int msb(uint64_t value);
 
 /* Returns the number of trailing zeros in 'value' */
-static unsigned int ntz(unsigned int value);
+static unsigned int ntz(uint64_t value);
 
-/* Shift an array by bit one position to the left */
-static void shiftB(unsigned char *s, const unsigned int len) {
-    /* Carry of the previous byte */
-    int c1 = 0;
-    
-    /* Carry of the current byte */
-    int c2 = 0;
+/* Compares the 16-byte tags at x and y in time independent of their contents. Returns 0 if they are equal. */
+static int tagCompare(const unsigned char *x, const unsigned char *y);
 
-    int i = len - 1;
-    while (i >= 0) {
-        /* If the first bit of the current byte is one, carry true */
-        if ((s[i])&0x80) c2 = 1;
+/* Xor of the 16-byte blocks at x and y stored at z, in two 64-bit words */
+static void xorBlock(unsigned char *z, const unsigned char *x, const unsigned char *y) {
 
-        s[i] = (s[i])<<1;
-        /* If there is previous carry, last bit of current byte to one */
-        if (c1 == 1) s[i] = s[i] | 0x01;
-        c1 = c2;
-        c2 = 0;
-        --i;
-    }
+    uint64_t a[2], b[2];
+    memcpy(a, x, 16);
+    memcpy(b, y, 16);
+    a[0] ^= b[0];
+    a[1] ^= b[1];
+    memcpy(z, a, 16);
 }
 
-/* Double function of the specification of OCB */
-static void doubleB(unsigned char *l, const unsigned int len) {
-    
-    /* If first bit of the byte is one, shifting and xor with 135 */
-    if ((l[0])&0x80) {
-        shiftB(l, len);
-        l[len - 1] = l[len - 1] ^ 0x87;    
+/* Big-endian 64-bit word at b */
+static uint64_t load64(const unsigned char *b) {
+
+    uint64_t w = 0;
+    int i;
+    for (i = 0; i < 8; ++i) {
+        w = (w << 8) | b[i];
     }
-    /* If it is zero, only shifting */
-    else shiftB(l, len);
+    return w;
 }
 
-/* Under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n, encrypt the plaintext at p and store it at c. 
-   The length of the plaintext is a multiple of 16 bytes given at len (e.g., len = 2 for a 32-byte p). The length of the
-   ciphertext c is (len+1)*16 bytes. */
-void aes128ocb(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *p, const unsigned int len) {
+/* Store the 64-bit word w at b in big-endian order */
+static void store64(unsigned char *b, uint64_t w) {
 
-    /* Array of zeros for use with aes128e */
-    unsigned char zeros[16];
     int i;
-    for (i = 0; i < 16; ++i) {
-        zeros[i] = 0x00;
+    for (i = 7; i >= 0; --i) {
+        b[i] = (unsigned char)w;
+        w >>= 8;
     }
+}
+
+/* Encrypts the nblocks blocks at in under key and stores them at out, with the round keys sliced at
+   expansion when the bitsliced backend is selected */
+static void encBlocks(unsigned char *out, const unsigned char *in, size_t nblocks, const aes128ocb_key *key) {
+
+    aes128e_blocks_sk(out, in, nblocks, &key->ks, &key->sks);
+}
 
+/* Double function of the specification of OCB, on the block as two 64-bit words: shift to the left by one
+   bit and xor with 135 if the first bit was one */
+static void doubleB(unsigned char *l) {
+
+    uint64_t hi = load64(l);
+    uint64_t lo = load64(l + 8);
+    uint64_t carry = hi >> 63;
+
+    hi = (hi << 1) | (lo >> 63);
+    lo = (lo << 1) ^ (0x87 & (0 - carry));
+
+    store64(l, hi);
+    store64(l + 8, lo);
+}
+
+/* Computes the key-dependent values of OCB under the AES key schedule of key: l_star, l_dollar and l_0.
+   The rest of the table ls is filled by extendL() */
+static void keySetup(aes128ocb_key *key) {
+
+    /* Array of zeros for use with aes128e */
+    unsigned char zeros[16];
     unsigned char l[16];
-    unsigned char l_dollar[16];
 
-    aes128e(l, zeros, k);
+    CRYPTOFN_STATS_START(t0);
+    memset(zeros, 0, 16);
+
+    encBlocks(l, zeros, 1, key);
     /* Now l is l_star */
+    memcpy(key->l_star, l, 16);
 
-    doubleB(l, 16);
+    doubleB(l);
     /* Now l is l_dollar */
+    memcpy(key->l_dollar, l, 16);
 
-    /* We keep l_dollar for using it for calculate the tag */
-    for (i = 0; i < 16; ++i) {
-        l_dollar[i] = l[i];
+    doubleB(l);
+    /* Now l is l_0 */
+    memcpy(key->ls[0], l, 16);
+    key->nls = 1;
+    CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_LTABLE, 0, 3);
+}
+
+/* Fills the table ls of key up to l_{ntz(i)} for every block index i up to m (the whole table if m is
+   UINT64_MAX) */
+static void extendL(aes128ocb_key *key, uint64_t m) {
+
+    /* numL is the maximum value of trailing zeros for the given size m, plus one */
+    unsigned int numL = m == UINT64_MAX ? 64 : msb(m) + 1;
+    if (key->nls >= numL) return;
+
+    CRYPTOFN_STATS_START(t0);
+    unsigned int first = key->nls;
+    while (key->nls < numL) {
+        memcpy(key->ls[key->nls], key->ls[key->nls - 1], 16);
+        doubleB(key->ls[key->nls]);
+        ++key->nls;
     }
+    CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_LTABLE, 0, numL - first);
+    (void)first;
+}
 
-    doubleB(l, 16);
-    /* Now l is l_0 */
+/* Stores at top the nonce block 0x00000001 || n of the 12-byte nonce at n with its last 6 bits to zero, and
+   returns bottom, the integer value of those 6 bits */
+static unsigned int nonceTop(unsigned char *top, const unsigned char *n) {
 
-    /* m = bitlen(P)/128 */
-    unsigned int m = ((16*len)*8)/128;
+    top[0] = top[1] = top[2] = 0x00;
+    top[3] = 0x01;
+    memcpy(top + 4, n, 12);
 
-    /* numL is the maximum value of trailing zeros for the given size m */
-    unsigned int numL = msb(m) + 1;
+    unsigned int bottom = top[15]&0x3F;
+    top[15] &= 0xC0;
+    return bottom;
+}
 
-    /* ls is the array of all the l_i arrays */
-    unsigned char ls[numL][16];
+/* Stretch is ktop concatenated with the xor of the bits 1...64 and 9...72 of ktop, as three 64-bit words */
+static void stretchOf(uint64_t *stretch, const unsigned char *ktop) {
 
-    int a;
-    for (a = 0; a < numL; ++a) {
-        for (i = 0; i < 16; ++i) {
-            ls[a][i] = l[i];
-        }
-        doubleB(l, 16);
-    }
+    stretch[0] = load64(ktop);
+    stretch[1] = load64(ktop + 8);
+    stretch[2] = stretch[0] ^ ((stretch[0] << 8) | (stretch[1] >> 56));
+}
 
-    /* Addition of 0x00000001 to the nonce */
-    unsigned char nonce[20];
-    nonce[0] = nonce[1] = nonce[2] = 0x00;
-    nonce[3] = 0x01;
+/* offset_0 is stretch[1 + bottom...128 + bottom], a shift of the three words by bottom bits */
+static void stretchOffset(unsigned char *offset, const uint64_t *stretch, unsigned int bottom) {
 
-    a = 0;
-    for (i = 4; i < 20; ++i) {
-        nonce[i] = n[a];
-        ++a;
+    uint64_t hi = stretch[0];
+    uint64_t lo = stretch[1];
+    if (bottom) {
+        hi = (hi << bottom) | (lo >> (64 - bottom));
+        lo = (lo << bottom) | (stretch[2] >> (64 - bottom));
     }
+    store64(offset, hi);
+    store64(offset + 8, lo);
+}
 
-    /* Bottom is the integer value of the last 6 bits of nonce */
-    unsigned int bottom = nonce[15]&0x3F;
+/* Computes offset_0 for the 12-byte nonce at n. With a nonce memo ns, the stretch of the previous nonce is
+   reused when the nonce has the same top and the memo is for the same key (its l_star is compared, in
+   constant time), and is kept for the next nonce otherwise */
+static void nonceOffset(const aes128ocb_key *key, aes128ocb_nonce *ns, const unsigned char *n, unsigned char *offset) {
 
-    /* Temporal array for aes128e with last 6 bits of nonce to zero */
+    CRYPTOFN_STATS_START(t0);
     unsigned char top[16];
-    
-    for (i = 0; i < 16; ++i) {
-        top[i] = nonce[i];
+    unsigned char ktop[16];
+    uint64_t stretch[3];
+    unsigned int bottom = nonceTop(top, n);
+
+    if (ns != NULL && ns->valid && memcmp(ns->top, top, 16) == 0 && tagCompare(ns->l_star, key->l_star) == 0) {
+        stretchOffset(offset, ns->stretch, bottom);
+        CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_NONCE, 0, 0);
+        return;
     }
-    top[15] = nonce[15]&0xC0;
 
     /* Calculation of ktop using the block cipher */
-    unsigned char ktop[16];
+    encBlocks(ktop, top, 1, key);
+    stretchOf(stretch, ktop);
+    stretchOffset(offset, stretch, bottom);
 
-    aes128e(ktop, top, k);
+    if (ns != NULL) {
+        memcpy(ns->l_star, key->l_star, 16);
+        memcpy(ns->top, top, 16);
+        memcpy(ns->stretch, stretch, sizeof stretch);
+        ns->valid = 1;
+    }
+    CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_NONCE, 0, 1);
+}
 
-    /* Stretch is ktop concatenated with the xor of the bits 1...64 and 9...72 of ktop */
-    unsigned char stretch[24];
-    
-    for (i = 0; i < 16; ++i) {
-        stretch[i] = ktop[i];
+/* Encrypts (dec == 0) or decrypts (dec == 1) under key the m blocks at in, which are the blocks
+   first+1 to first+m of the message, and stores them at out, updating the running offset and the checksum
+   of the plaintext. Only the current offset is kept: offset_i is computed from offset_{i-1} and l_{ntz(i)}
+   when block i is reached, so the memory used does not depend on m. */
+static void ocbBlocks(unsigned char *out, const unsigned char *in, uint64_t first, size_t m, const aes128ocb_key *key,
+                      int dec, unsigned char *offset, unsigned char *checksum) {
+
+    /* Offsets of the blocks of the current iteration and temporal arrays for use them with aes128 as
+       input and output, OCB_WIDE blocks at a time */
+    unsigned char offsets[OCB_WIDE*16];
+    unsigned char temp1[OCB_WIDE*16];
+    unsigned char temp2[OCB_WIDE*16];
+
+    int ntzV;
+    size_t i, b, nb;
+
+    CRYPTOFN_STATS_START(t0);
+
+    /* Loop over the m blocks, OCB_WIDE blocks per iteration */
+    for (i = 1; i <= m; i += nb) {
+
+        nb = (m - i + 1 < OCB_WIDE) ? (m - i + 1) : OCB_WIDE;
+
+        /* The offsets only depend on the L table, so the offsets of the nb blocks are computed up front
+           and the blocks are processed together with several block cipher calls in flight */
+        for (b = 0; b < nb; ++b) {
+
+            /* Number of trailing zeros in i + b */
+            ntzV = ntz(first + i + b);
+
+            /* Calculation of the offset_{i+b} with xor betwen offset_{i+b-1} and l_{ntz(i+b)} */
+            xorBlock(offset, offset, key->ls[ntzV]);
+            memcpy(offsets + 16*b, offset, 16);
+
+            /* Calculation of xor betwen the block i+b and offset_{i+b} for use it in aes128 */
+            xorBlock(temp1 + 16*b, in + 16*(i + b - 1), offset);
+        }
+
+        if (dec) aes128d_blocks_sk(temp2, temp1, nb, &key->dk, &key->sdk);
+        else encBlocks(temp2, temp1, nb, key);
+
+        for (b = 0; b < nb; ++b) {
+
+            /* Calculation of checksum_{i+b} with the xor betwen checksum_{i+b-1} and p_{i+b} */
+            if (!dec) xorBlock(checksum, checksum, in + 16*(i + b - 1));
+
+            /* Calculation of the output block i+b with xor betwen offset_{i+b} and result of aes128 */
+            xorBlock(out + 16*(i + b - 1), offsets + 16*b, temp2 + 16*b);
+
+            if (dec) xorBlock(checksum, checksum, out + 16*(i + b - 1));
+        }
     }
-    a = 0;
-    for (i = 16; i < 24; ++i) {
-        stretch[i] = (ktop[a] ^ ktop[a + 1]);
-        ++a;
+    if (m > 0) CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_BLOCKS, 16*(uint64_t)m, m);
+}
+
+/* Computes offset_i directly from offset_0: offset_i is offset_0 xored with the l_j of the bits set in the
+   Gray code of i, since going from i-1 to i flips exactly bit ntz(i) of the Gray code */
+static void offsetAt(unsigned char *offset, const unsigned char *offset0, const unsigned char ls[64][16], uint64_t i) {
+
+    uint64_t g = i ^ (i >> 1);
+    int j;
+
+    memcpy(offset, offset0, 16);
+    for (j = 0; g != 0; ++j, g >>= 1) {
+        if (g & 1) xorBlock(offset, offset, ls[j]);
     }
+}
 
-    /* Array of the m offset arrays */
-    unsigned char offset[m][16];
+/* Encrypts (dec == 0) or decrypts (dec == 1) the last len bytes (0 < len < 16) of the message at in and
+   stores them at out: offset_* is offset_m xor l_star, and the block is xored with the encryption of
+   offset_*. The checksum is updated with the plaintext padded with a one bit and zeros. */
+static void partialBlock(unsigned char *out, const unsigned char *in, size_t len, const aes128ocb_key *key, int dec,
+                         unsigned char *offset, unsigned char *checksum) {
 
-    /* Array of the m checksum arrays */
-    unsigned char checksum[m][16];
+    unsigned char pad[16];
+    unsigned char last[16];
 
-    /* Temporal array for get stretch[1 + bottom...128 + bottom] */
-    unsigned char tempS[24];
-    
-    for (i = 0; i < 24; ++i) {
-        tempS[i] = stretch[i];
+    CRYPTOFN_STATS_START(t0);
+    xorBlock(offset, offset, key->l_star);
+    encBlocks(pad, offset, 1, key);
+
+    memset(last, 0, 16);
+    memcpy(last, in, len);
+    xorBlock(pad, pad, last);
+
+    /* The plaintext of the last block with the padding 10* is added to the checksum */
+    if (dec) memcpy(last, pad, len);
+    last[len] = 0x80;
+    xorBlock(checksum, checksum, last);
+
+    memcpy(out, pad, len);
+    CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_BLOCKS, len, 1);
+}
+
+/* Adds the m full blocks of associated data at a, which are the blocks first+1 to first+m, to the sum of the
+   HASH function. The offsets of the associated data start from zero and use the same l table; the blocks
+   are independent, so OCB_WIDE of them are encrypted together. */
+static void hashBlocks(const unsigned char *a, uint64_t first, size_t m, const aes128ocb_key *key,
+                       unsigned char *offset, unsigned char *sum) {
+
+    unsigned char temp1[OCB_WIDE*16];
+    unsigned char temp2[OCB_WIDE*16];
+
+    size_t i, b, nb;
+
+    CRYPTOFN_STATS_START(t0);
+    for (i = 1; i <= m; i += nb) {
+
+        nb = (m - i + 1 < OCB_WIDE) ? (m - i + 1) : OCB_WIDE;
+
+        /* Calculation of the xor betwen a_{i+b} and its offset for use it in aes128 */
+        for (b = 0; b < nb; ++b) {
+            xorBlock(offset, offset, key->ls[ntz(first + i + b)]);
+            xorBlock(temp1 + 16*b, a + 16*(i + b - 1), offset);
+        }
+
+        encBlocks(temp2, temp1, nb, key);
+
+        for (b = 0; b < nb; ++b) {
+            xorBlock(sum, sum, temp2 + 16*b);
+        }
     }
+    if (m > 0) CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_AD, 16*(uint64_t)m, m);
+}
+
+/* Adds the last len bytes (0 < len < 16) of associated data at a, padded with a one bit and zeros, to the sum
+   of the HASH function */
+static void hashPartial(const unsigned char *a, size_t len, const aes128ocb_key *key, unsigned char *offset,
+                        unsigned char *sum) {
+
+    unsigned char last[16];
+
+    CRYPTOFN_STATS_START(t0);
+    memset(last, 0, 16);
+    memcpy(last, a, len);
+    last[len] = 0x80;
+
+    xorBlock(offset, offset, key->l_star);
+    xorBlock(last, last, offset);
+    encBlocks(last, last, 1, key);
+    xorBlock(sum, sum, last);
+    CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_AD, len, 1);
+}
+
+/* Computes the tag from the checksum, the final offset and l_dollar, and adds the HASH of the associated
+   data at sum */
+static void computeTag(unsigned char *t, const aes128ocb_key *key, const unsigned char *offset, const unsigned char *checksum,
+                       const unsigned char *sum) {
 
-    /* Shifting of stretch bottom times to the left */
-    for (i = 0; i < bottom; ++i) {
-        shiftB(tempS, 24);
+    unsigned char tempTag[16];
+
+    CRYPTOFN_STATS_START(t0);
+
+    /* Calculation of the xor betwen checksum_m, offset_m and l_dollar for use it in aes128 to calculate the tag */
+    int w;
+    for (w = 0; w < 16; ++w) {
+        tempTag[w] = ((key->l_dollar[w] ^ offset[w]) ^ checksum[w]);
     }
 
-    /* Copy of temp array to offset and inicialization of checksum */
+    encBlocks(t, tempTag, 1, key);
+    xorBlock(t, t, sum);
+    CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_TAG, 0, 1);
+}
+
+/* Compares the 16-byte tags at x and y in time independent of their contents. Returns 0 if they are equal. */
+static int tagCompare(const unsigned char *x, const unsigned char *y) {
+
+    unsigned char d = 0;
+    int i;
     for (i = 0; i < 16; ++i) {
-        offset[0][i] = tempS[i];
-        checksum[0][i] = 0x00;
+        d |= x[i] ^ y[i];
     }
+    /* 0 if d is zero, -1 otherwise, without a branch on d */
+    return -(int)((d + 0xFFu) >> 8);
+}
 
-    /* Temporal arrays for use them with aes128 as plaintext and ciphertext */
-    unsigned char temp1[16];
-    unsigned char temp2[16];
+/* Expands the 16-byte key at k into the private key of a single message of up to m blocks (of message or
+   associated data): the L table is only filled as far as the message needs, and the decryption key schedule
+   only if dec is set. The schedules are sliced once here for the bitsliced backend. */
+static void expandFor(aes128ocb_key *key, const unsigned char *k, uint64_t m, int dec) {
 
-    int ntzV;
+    aes128_expand_key(&key->ks, k);
+    aes128_slice_key(&key->sks, &key->ks);
+    key->sdk.sliced = 0;
+    if (dec) {
+        aes128_expand_dkey(&key->dk, &key->ks);
+        aes128_slice_dkey(&key->sdk, &key->dk);
+    }
+    keySetup(key);
+    extendL(key, m);
+}
+
+/* Expand the 16-byte key at k into key: the AES key schedules and the whole L table of OCB. */
+void aes128ocb_expand_key(aes128ocb_key *key, const unsigned char *k) {
+
+    expandFor(key, k, UINT64_MAX, 1);
+}
 
-    /* Counters */
-    int countP1 = 0;
-    int countP2 = 0;
-    int countC = 0;
-    
-    /* Loop over the m blocks */
-    for (i = 1; i <= m; ++i) {
+/* An entry of the key cache: a full OCB key, with the nonce memo of the messages of its thread under it */
+struct cacheEntry {
+    aes128ocb_key key;
+    aes128ocb_nonce ns;
+};
+
+/* Expands an entry of the key cache */
+static void cacheExpand(void *entry, const unsigned char *k) {
+
+    struct cacheEntry *e = entry;
+    aes128ocb_expand_key(&e->key, k);
+    aes128ocb_nonce_clear(&e->ns);
+}
+
+/* Entries of the key cache, for aes128ocb_encrypt() and aes128ocb_decrypt() */
+static const aes128_cache_kind cacheKind = { AES128_CACHE_OCB, sizeof(struct cacheEntry), cacheExpand };
+
+/* Clear the key material at key. */
+void aes128ocb_wipe_key(aes128ocb_key *key) {
+
+    wipe(key, 0, sizeof *key);
+}
+
+/* Clear the nonce memo at ns. */
+void aes128ocb_nonce_clear(aes128ocb_nonce *ns) {
+
+    wipe(ns, 0, sizeof *ns);
+}
+
+/* Same as aes128ocb_encrypt(), under the expanded key at key and with the nonce memo at ns (or NULL). c may
+   equal p. */
+void aes128ocb_encrypt_ks(unsigned char *c, const aes128ocb_key *key, aes128ocb_nonce *ns, const unsigned char *n,
+                          const unsigned char *a, size_t alen, const unsigned char *p, size_t plen) {
+
+    /* m = bitlen(P)/128 and ma = bitlen(A)/128, full blocks only */
+    size_t m = plen/16;
+    size_t ma = alen/16;
+
+    unsigned char offset[16];
+    unsigned char checksum[16];
+    unsigned char offsetA[16];
+    unsigned char sum[16];
+
+    nonceOffset(key, ns, n, offset);
+    memset(checksum, 0, 16);
+    memset(offsetA, 0, 16);
+    memset(sum, 0, 16);
+
+    hashBlocks(a, 0, ma, key, offsetA, sum);
+    if (alen%16) hashPartial(a + 16*ma, alen%16, key, offsetA, sum);
+
+    ocbBlocks(c, p, 0, m, key, 0, offset, checksum);
+    if (plen%16) partialBlock(c + 16*m, p + 16*m, plen%16, key, 0, offset, checksum);
+
+    computeTag(c + plen, key, offset, checksum, sum);
+}
+
+/* Same as aes128ocb_decrypt(), under the expanded key at key and with the nonce memo at ns (or NULL). */
+int aes128ocb_decrypt_ks(unsigned char *p, const aes128ocb_key *key, aes128ocb_nonce *ns, const unsigned char *n,
+                         const unsigned char *a, size_t alen, const unsigned char *c, size_t clen) {
+
+    if (clen < 16) return -1;
+    size_t plen = clen - 16;
+
+    size_t m = plen/16;
+    size_t ma = alen/16;
+
+    unsigned char offset[16];
+    unsigned char checksum[16];
+    unsigned char offsetA[16];
+    unsigned char sum[16];
+
+    nonceOffset(key, ns, n, offset);
+    memset(checksum, 0, 16);
+    memset(offsetA, 0, 16);
+    memset(sum, 0, 16);
+
+    hashBlocks(a, 0, ma, key, offsetA, sum);
+    if (alen%16) hashPartial(a + 16*ma, alen%16, key, offsetA, sum);
+
+    ocbBlocks(p, c, 0, m, key, 1, offset, checksum);
+    if (plen%16) partialBlock(p + 16*m, c + 16*m, plen%16, key, 1, offset, checksum);
+
+    unsigned char t[16];
+    computeTag(t, key, offset, checksum, sum);
+
+    /* The plaintext is released only if the tag is valid */
+    if (tagCompare(t, c + plen) != 0) {
+        memset(p, 0, plen);
+        return -1;
+    }
+    return 0;
+}
+
+/* Under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n, authenticate the alen bytes of associated
+   data at a, encrypt the plen bytes of plaintext at p and store the ciphertext at c followed by the 16-byte tag (plen+16
+   bytes). Any of the lengths may be zero and need not be a multiple of 16 (RFC 7253). */
+void aes128ocb_encrypt(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *a, size_t alen,
+                       const unsigned char *p, size_t plen) {
+
+    /* With the key cache enabled, a key seen recently by this thread is already expanded, and the Ktop of its
+       last nonce is kept with it */
+    struct cacheEntry *cached = aes128_cache_acquire(&cacheKind, k);
+    if (cached != NULL) {
+        aes128ocb_encrypt_ks(c, &cached->key, &cached->ns, n, a, alen, p, plen);
+        aes128_cache_release();
+        return;
+    }
+
+    aes128ocb_key key;
+    expandFor(&key, k, plen/16 > alen/16 ? plen/16 : alen/16, 0);
+    aes128ocb_encrypt_ks(c, &key, NULL, n, a, alen, p, plen);
+    aes128ocb_wipe_key(&key);
+}
 
-        /* Number of trailing zeros in i */
-        ntzV = ntz(i);
+/* Under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n, check the clen bytes at c (ciphertext followed
+   by the 16-byte tag) against the alen bytes of associated data at a, and decrypt the ciphertext at p (clen-16 bytes).
+   Returns 0 if the tag is valid and -1 otherwise; on failure p is cleared. */
+int aes128ocb_decrypt(unsigned char *p, const unsigned char *k, const unsigned char *n, const unsigned char *a, size_t alen,
+                      const unsigned char *c, size_t clen) {
 
-        /* Calculation of the offset_i with xor betwen offset_{i-1} and l_{ntz(i)} */
-        for (a = 0; a < 16; ++a) {
-            offset[i][a] = offset[i - 1][a] ^ ls[ntzV][a];
+    struct cacheEntry *cached = aes128_cache_acquire(&cacheKind, k);
+    if (cached != NULL) {
+        int ret = aes128ocb_decrypt_ks(p, &cached->key, &cached->ns, n, a, alen, c, clen);
+        aes128_cache_release();
+        return ret;
+    }
+
+    aes128ocb_key key;
+    size_t m = clen >= 16 ? (clen - 16)/16 : 0;
+    expandFor(&key, k, m > alen/16 ? m : alen/16, 1);
+    int ret = aes128ocb_decrypt_ks(p, &key, NULL, n, a, alen, c, clen);
+    aes128ocb_wipe_key(&key);
+    return ret;
+}
+
+/* Position in a list of buffer fragments */
+struct iovCursor {
+    const struct iovec *v;
+    int n;
+    int i;
+    size_t off;
+};
+
+/* Number of bytes left in the current fragment of cur, after skipping the fragments that are used up */
+static size_t iovAvail(struct iovCursor *cur) {
+
+    while (cur->i < cur->n && cur->off == cur->v[cur->i].iov_len) {
+        ++cur->i;
+        cur->off = 0;
+    }
+    return cur->i < cur->n ? cur->v[cur->i].iov_len - cur->off : 0;
+}
+
+/* Address of the current byte of cur */
+static unsigned char *iovPtr(const struct iovCursor *cur) {
+
+    return (unsigned char *)cur->v[cur->i].iov_base + cur->off;
+}
+
+/* Copies len bytes between the fragments of cur and buf (to buf if toBuf, from buf otherwise) and advances cur */
+static void iovCopy(struct iovCursor *cur, unsigned char *buf, size_t len, int toBuf) {
+
+    while (len > 0) {
+        size_t take = iovAvail(cur);
+        if (take > len) take = len;
+        if (toBuf) memcpy(buf, iovPtr(cur), take);
+        else memcpy(iovPtr(cur), buf, take);
+        cur->off += take;
+        buf += take;
+        len -= take;
+    }
+}
+
+/* Under the expanded key at key and the 12-byte nonce at n, encrypt the message held in the n_in fragments of in and
+   store the ciphertext in the n_out fragments of out, which need not be split at the same places, and the 16-byte tag
+   at tag. Runs of complete blocks that lie within one input and one output fragment are encrypted in place; only the
+   blocks that straddle a fragment boundary are copied through a 16-byte buffer. out may be the same list as in.
+   Returns 0, or -1 if out is shorter than in. */
+int aes128ocb_encryptv(const aes128ocb_key *key, const unsigned char *n, const struct iovec *in, int n_in, struct iovec *out,
+                       int n_out, unsigned char *tag) {
+
+    size_t plen = 0, room = 0;
+    int f;
+    for (f = 0; f < n_in; ++f) {
+        plen += in[f].iov_len;
+    }
+    for (f = 0; f < n_out; ++f) {
+        room += out[f].iov_len;
+    }
+    if (room < plen) return -1;
+
+    struct iovCursor src = { in, n_in, 0, 0 };
+    struct iovCursor dst = { out, n_out, 0, 0 };
+
+    uint64_t m = plen/16;
+    uint64_t done = 0;
+
+    unsigned char offset[16];
+    unsigned char checksum[16];
+    unsigned char zeros[16];
+    unsigned char buf[16];
+
+    nonceOffset(key, NULL, n, offset);
+    memset(checksum, 0, 16);
+    memset(zeros, 0, 16);
+
+    while (done < m) {
+        size_t run = iovAvail(&src);
+        size_t runOut = iovAvail(&dst);
+        if (runOut < run) run = runOut;
+        run /= 16;
+        if (run > m - done) run = m - done;
+
+        if (run > 0) {
+            ocbBlocks(iovPtr(&dst), iovPtr(&src), done, run, key, 0, offset, checksum);
+            src.off += 16*run;
+            dst.off += 16*run;
+            done += run;
+        }
+        else {
+            /* A block across a fragment boundary */
+            iovCopy(&src, buf, 16, 1);
+            ocbBlocks(buf, buf, done, 1, key, 0, offset, checksum);
+            iovCopy(&dst, buf, 16, 0);
+            done += 1;
+        }
+    }
+
+    if (plen%16) {
+        iovCopy(&src, buf, plen%16, 1);
+        partialBlock(buf, buf, plen%16, key, 0, offset, checksum);
+        iovCopy(&dst, buf, plen%16, 0);
+    }
+
+    computeTag(tag, key, offset, checksum, zeros);
+    return 0;
+}
+
+/* Messages of aes128ocb_batch() whose per-message state is kept at the same time */
+#define OCB_BATCH_GROUP 64
+
+/* Kinds of the blocks gathered by aes128ocb_batch() */
+enum { HASH_FULL, HASH_PART, MSG_FULL, MSG_PART };
+
+/* A block of a batch: which message and which part of it the encryption of the block is for */
+struct batchSlot {
+    size_t job;
+    int kind;
+    unsigned char *out;
+    const unsigned char *in;
+    size_t len;
+    unsigned char offset[16];
+};
+
+/* Encrypts the nb gathered blocks at temp1 together and finishes each of them: the associated data
+   blocks go to the sum of their message, and the message blocks to its ciphertext */
+static void batchFlush(const aes128ocb_key *key, struct batchSlot *slots, size_t nb, unsigned char *temp1,
+                       unsigned char (*sums)[16]) {
+
+    unsigned char temp2[OCB_WIDE*16];
+    size_t b, i;
+
+    encBlocks(temp2, temp1, nb, key);
+
+    for (b = 0; b < nb; ++b) {
+        struct batchSlot *sl = &slots[b];
+        if (sl->kind == MSG_FULL) {
+            xorBlock(sl->out, sl->offset, temp2 + 16*b);
+        }
+        else if (sl->kind == MSG_PART) {
+            for (i = 0; i < sl->len; ++i) {
+                sl->out[i] = sl->in[i] ^ temp2[16*b + i];
+            }
+        }
+        else {
+            xorBlock(sums[sl->job], sums[sl->job], temp2 + 16*b);
+        }
+    }
+}
+
+/* Encrypt the njobs independent messages of jobs under the expanded key at key. The blocks of different
+   messages are gathered into the same calls to the block cipher, OCB_WIDE at a time, and so are the Ktop
+   and tag computations of up to OCB_BATCH_GROUP messages. The Ktop of the last nonce top of a group is
+   kept for the next group, so counter nonces need one block cipher call every 64 messages. The output of
+   each job is the same as with aes128ocb_encrypt_ks(). */
+void aes128ocb_batch(const aes128ocb_key *key, const aes128ocb_job *jobs, size_t njobs) {
+
+    unsigned char offsets[OCB_BATCH_GROUP][16];
+    unsigned char checksums[OCB_BATCH_GROUP][16];
+    unsigned char sums[OCB_BATCH_GROUP][16];
+    unsigned char tops[OCB_BATCH_GROUP*16];
+    unsigned char ktops[OCB_BATCH_GROUP*16];
+    uint64_t stretches[OCB_BATCH_GROUP + 1][3];
+    unsigned int bottoms[OCB_BATCH_GROUP];
+    size_t ktopOf[OCB_BATCH_GROUP];
+    unsigned char lastTop[16];
+    int haveTop = 0;
+
+    struct batchSlot slots[OCB_WIDE];
+    unsigned char temp1[OCB_WIDE*16];
+    size_t nb = 0;
+
+    size_t g, j, ng, i;
+
+    CRYPTOFN_STATS_START(t0);
+    for (g = 0; g < njobs; g += ng) {
+
+        const aes128ocb_job *jb = jobs + g;
+        ng = njobs - g < OCB_BATCH_GROUP ? njobs - g : OCB_BATCH_GROUP;
+
+        /* Ktop of every distinct nonce top of the group that is not the one kept from the previous group, in one call. Counter
+           nonces share their top with the previous message, so only a change of top is a new block. */
+        size_t nk = 0;
+        for (j = 0; j < ng; ++j) {
+            bottoms[j] = nonceTop(tops + 16*nk, jb[j].n);
+            if (haveTop && memcmp(tops + 16*nk, lastTop, 16) == 0) {
+                ktopOf[j] = OCB_BATCH_GROUP;
+            }
+            else if (nk > 0 && memcmp(tops + 16*nk, tops + 16*(nk - 1), 16) == 0) {
+                ktopOf[j] = nk - 1;
+            }
+            else {
+                ktopOf[j] = nk++;
+            }
         }
+        encBlocks(ktops, tops, nk, key);
 
-        /* Calculation of xor betwen p_i and offset_i for use it in aes128 */
-        for (a = 0; a < 16; ++a) {
-            temp1[a] = (p[countP1] ^ offset[i][a]);
-            ++countP1;
+        /* The stretch kept from the previous group is the last entry */
+        for (j = 0; j < nk; ++j) {
+            stretchOf(stretches[j], ktops + 16*j);
         }
-        
-        aes128e(temp2, temp1, k);
 
-        /* Calculation of c_i with xor betwen offset_i and result of aes128 */
-        for (a = 0; a < 16; ++a) {
-           c[countC] = offset[i][a] ^ temp2[a];
-           ++countC;
+        for (j = 0; j < ng; ++j) {
+            stretchOffset(offsets[j], stretches[ktopOf[j]], bottoms[j]);
+            memset(checksums[j], 0, 16);
+            memset(sums[j], 0, 16);
+        }
+        if (nk > 0) {
+            memcpy(lastTop, tops + 16*(nk - 1), 16);
+            memcpy(stretches[OCB_BATCH_GROUP], stretches[nk - 1], sizeof stretches[0]);
+            haveTop = 1;
         }
 
-        /* Calculation of checksum_i with the xor betwen checksum_{i-1} and p_i */
-        for (a = 0; a < 16; ++a) {
-            checksum[i][a] = checksum[i - 1][a] ^ p[countP2];
-            ++countP2;
+        /* Every block of every message of the group goes through the same OCB_WIDE-block batches. The
+           checksum is taken when a block is gathered, so the plaintext may be overwritten in place. */
+        for (j = 0; j < ng; ++j) {
+
+            const aes128ocb_job *job = &jb[j];
+            unsigned char offsetA[16];
+            size_t m = job->plen/16;
+            size_t ma = job->alen/16;
+            unsigned char last[16];
+
+            memset(offsetA, 0, 16);
+
+            for (i = 0; i <= ma; ++i) {
+                if (i == ma && job->alen%16 == 0) break;
+
+                struct batchSlot *sl = &slots[nb];
+                sl->job = j;
+                if (i < ma) {
+                    sl->kind = HASH_FULL;
+                    xorBlock(offsetA, offsetA, key->ls[ntz(i + 1)]);
+                    xorBlock(temp1 + 16*nb, job->a + 16*i, offsetA);
+                }
+                else {
+                    sl->kind = HASH_PART;
+                    memset(last, 0, 16);
+                    memcpy(last, job->a + 16*ma, job->alen%16);
+                    last[job->alen%16] = 0x80;
+                    xorBlock(offsetA, offsetA, key->l_star);
+                    xorBlock(temp1 + 16*nb, last, offsetA);
+                }
+                if (++nb == OCB_WIDE) {
+                    batchFlush(key, slots, nb, temp1, sums);
+                    nb = 0;
+                }
+            }
+
+            for (i = 0; i <= m; ++i) {
+                if (i == m && job->plen%16 == 0) break;
+
+                struct batchSlot *sl = &slots[nb];
+                sl->job = j;
+                sl->out = job->c + 16*i;
+                sl->in = job->p + 16*i;
+                if (i < m) {
+                    sl->kind = MSG_FULL;
+                    xorBlock(offsets[j], offsets[j], key->ls[ntz(i + 1)]);
+                    memcpy(sl->offset, offsets[j], 16);
+                    xorBlock(checksums[j], checksums[j], sl->in);
+                    xorBlock(temp1 + 16*nb, sl->in, offsets[j]);
+                }
+                else {
+                    /* The pad is the encryption of offset_*, and the ciphertext its xor with the last bytes */
+                    sl->kind = MSG_PART;
+                    sl->len = job->plen%16;
+                    memset(last, 0, 16);
+                    memcpy(last, sl->in, sl->len);
+                    last[sl->len] = 0x80;
+                    xorBlock(checksums[j], checksums[j], last);
+                    xorBlock(offsets[j], offsets[j], key->l_star);
+                    memcpy(temp1 + 16*nb, offsets[j], 16);
+                }
+                if (++nb == OCB_WIDE) {
+                    batchFlush(key, slots, nb, temp1, sums);
+                    nb = 0;
+                }
+            }
+        }
+        if (nb > 0) {
+            batchFlush(key, slots, nb, temp1, sums);
+            nb = 0;
+        }
+
+        /* The tags of the group in one call: the encryption of checksum xor offset xor l_dollar, plus the
+           HASH of the associated data */
+        for (j = 0; j < ng; ++j) {
+            xorBlock(tops + 16*j, checksums[j], offsets[j]);
+            xorBlock(tops + 16*j, tops + 16*j, key->l_dollar);
+        }
+        encBlocks(ktops, tops, ng, key);
+        for (j = 0; j < ng; ++j) {
+            xorBlock(jb[j].c + jb[j].plen, ktops + 16*j, sums[j]);
         }
     }
 
-    unsigned char tag[16];
-    unsigned char tempTag[16];
-        
-    /* Calculation of the xor betwen checksum_m, offset_m and l_dollar for use it in aes128 to calculate the tag */
-    int w;
-    for (w = 0; w < 16; ++w) {
-        tempTag[w] = ((l_dollar[w] ^ offset[m][w]) ^ checksum[m][w]);
+#ifdef CRYPTOFN_STATS
+    uint64_t bytes = 0;
+    for (g = 0; g < njobs; ++g) {
+        bytes += jobs[g].plen;
     }
+    CRYPTOFN_STATS_STOP(t0, CRYPTOFN_STAT_OCB_BATCH, bytes, njobs);
+#endif
+}
+
+/* Work of one thread of aes128ocb_parallel_ks(): the blocks first+1 to first+m, with its own offset and
+   partial checksum */
+struct ocbSlice {
+    unsigned char *c;
+    const unsigned char *p;
+    uint64_t first;
+    size_t m;
+    const aes128ocb_key *key;
+    unsigned char offset[16];
+    unsigned char checksum[16];
+};
+
+/* Thread body of aes128ocb_parallel_ks() */
+static void *sliceWorker(void *arg) {
+
+    struct ocbSlice *w = arg;
+    ocbBlocks(w->c + 16*w->first, w->p + 16*w->first, w->first, w->m, w->key, 0, w->offset, w->checksum);
+    return NULL;
+}
+
+/* Task i of a caller's pool: slice i of the array at arg */
+static void sliceTask(void *arg, int i) {
+
+    sliceWorker((struct ocbSlice *)arg + i);
+}
+
+/* Same as aes128ocb_encrypt_ks(), with the full blocks of the plaintext split in nthreads contiguous slices that
+   are encrypted at the same time, on the threads of pool or on threads started for this call if pool is NULL.
+   The offset at the start of each slice is computed directly from its block index, and the partial checksums of
+   the slices are xored at the end, so the output is the same as with aes128ocb_encrypt_ks(). nthreads <= 0 uses
+   one thread per online processor, and at most AES128OCB_MAX_THREADS are used. Short messages, or a failure to
+   start a thread, fall back to fewer threads. */
+void aes128ocb_parallel_ks(unsigned char *c, const aes128ocb_key *key, const unsigned char *n, const unsigned char *a,
+                           size_t alen, const unsigned char *p, size_t plen, int nthreads, const aes128ocb_pool *pool) {
+
+    size_t m = plen/16;
+    size_t ma = alen/16;
+
+    unsigned char offset0[16];
+    unsigned char offset[16];
+    unsigned char checksum[16];
+    unsigned char offsetA[16];
+    unsigned char sum[16];
+
+    nonceOffset(key, NULL, n, offset0);
+    memset(checksum, 0, 16);
+    memset(offsetA, 0, 16);
+    memset(sum, 0, 16);
+
+    if (nthreads <= 0) {
+        long np = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = np > 0 ? (int)np : 1;
+    }
+    if (nthreads > AES128OCB_MAX_THREADS) nthreads = AES128OCB_MAX_THREADS;
+    if ((size_t)nthreads > m/OCB_PAR_MIN) nthreads = m/OCB_PAR_MIN > 0 ? (int)(m/OCB_PAR_MIN) : 1;
+
+    /* Slices are a multiple of OCB_WIDE blocks so that only the last one has a short batch */
+    struct ocbSlice w[AES128OCB_MAX_THREADS];
+    pthread_t tid[AES128OCB_MAX_THREADS];
+    int started[AES128OCB_MAX_THREADS];
+    size_t per = (m/nthreads + OCB_WIDE - 1)/OCB_WIDE*OCB_WIDE;
+    size_t first = 0;
+    int t;
+    for (t = 0; t < nthreads; ++t) {
+        w[t].c = c;
+        w[t].p = p;
+        w[t].first = first;
+        w[t].m = (t == nthreads - 1 || m - first < per) ? m - first : per;
+        w[t].key = key;
+        offsetAt(w[t].offset, offset0, key->ls, first);
+        memset(w[t].checksum, 0, 16);
+        first += w[t].m;
+    }
+
+    if (pool != NULL) {
+        /* The pool runs every slice, then the HASH of the associated data is computed here */
+        if (nthreads > 1) pool->run(pool->ctx, sliceTask, w, nthreads);
+        else sliceWorker(&w[0]);
+
+        hashBlocks(a, 0, ma, key, offsetA, sum);
+        if (alen%16) hashPartial(a + 16*ma, alen%16, key, offsetA, sum);
+
+        for (t = 0; t < nthreads; ++t) {
+            xorBlock(checksum, checksum, w[t].checksum);
+        }
+    }
+    else {
+        /* Slice 0 runs on the calling thread, which also computes the HASH of the associated data */
+        for (t = 1; t < nthreads; ++t) {
+            started[t] = pthread_create(&tid[t], NULL, sliceWorker, &w[t]) == 0;
+            if (!started[t]) sliceWorker(&w[t]);
+        }
+        sliceWorker(&w[0]);
+
+        hashBlocks(a, 0, ma, key, offsetA, sum);
+        if (alen%16) hashPartial(a + 16*ma, alen%16, key, offsetA, sum);
+
+        xorBlock(checksum, checksum, w[0].checksum);
+        for (t = 1; t < nthreads; ++t) {
+            if (started[t]) pthread_join(tid[t], NULL);
+            xorBlock(checksum, checksum, w[t].checksum);
+        }
+    }
+
+    /* The offset after the last full block is the one of the last slice */
+    memcpy(offset, w[nthreads - 1].offset, 16);
+
+    if (plen%16) partialBlock(c + 16*m, p + 16*m, plen%16, key, 0, offset, checksum);
+
+    computeTag(c + plen, key, offset, checksum, sum);
+}
+
+/* Same as aes128ocb_encrypt(), with the plaintext split across nthreads threads started for this call: the key
+   is expanded as far as the message needs and aes128ocb_parallel_ks() does the rest. */
+void aes128ocb_parallel(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *a, size_t alen,
+                        const unsigned char *p, size_t plen, int nthreads) {
+
+    size_t m = plen/16;
+    size_t ma = alen/16;
+
+    aes128ocb_key key;
+    expandFor(&key, k, m > ma ? m : ma, 0);
+    aes128ocb_parallel_ks(c, &key, n, a, alen, p, plen, nthreads, NULL);
+    aes128ocb_wipe_key(&key);
+}
 
-    aes128e(tag, tempTag, k);
+/* Under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n, encrypt the plaintext at p and store it at c.
+   The length of the plaintext is a multiple of 16 bytes given at len (e.g., len = 2 for a 32-byte p). The length of the
+   ciphertext c is (len+1)*16 bytes. */
+void aes128ocb(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *p, const size_t len) {
+
+    aes128ocb_encrypt(c, k, n, NULL, 0, p, 16*len);
+}
+
+/* Start the encryption of a message under the expanded key at key and the 12-byte nonce at n, with the nonce
+   memo at ns (or NULL). key is used until aes128ocb_final() and is not copied; ns only by this call. */
+void aes128ocb_init_ks(aes128ocb_ctx *ctx, const aes128ocb_key *key, aes128ocb_nonce *ns, const unsigned char *n) {
+
+    ctx->key = key;
+    nonceOffset(key, ns, n, ctx->offset);
+    memset(ctx->checksum, 0, 16);
+    ctx->blocks = 0;
+    ctx->buflen = 0;
+    memset(ctx->offsetA, 0, 16);
+    memset(ctx->sum, 0, 16);
+    ctx->ablocks = 0;
+    ctx->abuflen = 0;
+}
+
+/* Start the encryption of a message under the 16-byte key at k and the 12-byte nonce at n. The key is
+   expanded into ctx. */
+void aes128ocb_init(aes128ocb_ctx *ctx, const unsigned char *k, const unsigned char *n) {
+
+    expandFor(&ctx->own, k, UINT64_MAX, 0);
+    aes128ocb_init_ks(ctx, &ctx->own, NULL, n);
+    ctx->key = NULL;
+}
+
+/* Key used by ctx: its own copy when it was started by aes128ocb_init() */
+static const aes128ocb_key *ctxKey(const aes128ocb_ctx *ctx) {
+
+    return ctx->key ? ctx->key : &ctx->own;
+}
+
+/* Add the next alen bytes of associated data at a. May be called any number of times before aes128ocb_final(),
+   in any order with aes128ocb_update(). */
+void aes128ocb_ad(aes128ocb_ctx *ctx, const unsigned char *a, size_t alen) {
+
+    const aes128ocb_key *key = ctxKey(ctx);
+
+    /* Complete the block buffered by the previous call */
+    if (ctx->abuflen > 0) {
+        size_t take = 16 - ctx->abuflen;
+        if (take > alen) take = alen;
+        memcpy(ctx->abuf + ctx->abuflen, a, take);
+        ctx->abuflen += take;
+        a += take;
+        alen -= take;
+
+        if (ctx->abuflen < 16) return;
 
-    /* Concatenation of the tag at the end of the ciphertext. 16*m is the 
-    current lenght of the cipher lenght and 16*m +16 is the total lenght */
-    int countTag = 0;
-    for (a = 16*m; a < (16*m + 16); ++a) {
-        c[a] = tag[countTag];
-        ++countTag;
+        hashBlocks(ctx->abuf, ctx->ablocks, 1, key, ctx->offsetA, ctx->sum);
+        ctx->ablocks += 1;
+        ctx->abuflen = 0;
     }
+
+    size_t m = alen/16;
+    hashBlocks(a, ctx->ablocks, m, key, ctx->offsetA, ctx->sum);
+    ctx->ablocks += m;
+
+    ctx->abuflen = alen - 16*m;
+    memcpy(ctx->abuf, a + 16*m, ctx->abuflen);
+}
+
+/* Encrypt the next inlen bytes of the message at in. The complete blocks are written at out and their number
+   of bytes is returned; the remaining bytes (less than 16) are kept in ctx until the next call. out must have
+   room for inlen + 15 bytes. out may equal in as long as no bytes are kept from the previous call. */
+size_t aes128ocb_update(aes128ocb_ctx *ctx, const unsigned char *in, size_t inlen, unsigned char *out) {
+
+    const aes128ocb_key *key = ctxKey(ctx);
+    size_t written = 0;
+
+    /* Complete the block buffered by the previous call */
+    if (ctx->buflen > 0) {
+        size_t take = 16 - ctx->buflen;
+        if (take > inlen) take = inlen;
+        memcpy(ctx->buf + ctx->buflen, in, take);
+        ctx->buflen += take;
+        in += take;
+        inlen -= take;
+
+        if (ctx->buflen < 16) return 0;
+
+        ocbBlocks(out, ctx->buf, ctx->blocks, 1, key, 0, ctx->offset, ctx->checksum);
+        ctx->blocks += 1;
+        ctx->buflen = 0;
+        out += 16;
+        written = 16;
+    }
+
+    /* The complete blocks are encrypted straight from in to out */
+    size_t m = inlen/16;
+    ocbBlocks(out, in, ctx->blocks, m, key, 0, ctx->offset, ctx->checksum);
+    ctx->blocks += m;
+    written += 16*m;
+
+    /* Only the tail is copied */
+    ctx->buflen = inlen - 16*m;
+    memcpy(ctx->buf, in + 16*m, ctx->buflen);
+
+    return written;
+}
+
+/* Finish the message: the bytes kept from the last update (less than 16) are encrypted and written at out,
+   and the 16-byte tag is stored at t. Returns the number of bytes written at out. The state in ctx is
+   cleared, including the key expanded by aes128ocb_init(). */
+size_t aes128ocb_final(aes128ocb_ctx *ctx, unsigned char *out, unsigned char *t) {
+
+    const aes128ocb_key *key = ctxKey(ctx);
+    size_t written = ctx->buflen;
+
+    if (ctx->abuflen) hashPartial(ctx->abuf, ctx->abuflen, key, ctx->offsetA, ctx->sum);
+    if (ctx->buflen) partialBlock(out, ctx->buf, ctx->buflen, key, 0, ctx->offset, ctx->checksum);
+    computeTag(t, key, ctx->offset, ctx->checksum, ctx->sum);
+
+    wipe(ctx, 0, sizeof *ctx);
+    return written;
 }
 
 /* Returns the exponent of the msb of 'value' */
-static unsigned int msb(unsigned int value) {
+static unsigned int msb(uint64_t value) {
 
 	unsigned int index = 0;
 
@@ -228,7 +1087,7 @@ static unsigned int msb(unsigned int value) {
 }
 
 /* Returns the number of trailing zeros in 'value' */
-static unsigned int ntz(unsigned int value) {
+static unsigned int ntz(uint64_t value) {
 
 	unsigned int zeros = 0;
 
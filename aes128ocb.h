@@ -1,5 +1,150 @@
+#ifndef AES128OCB_H
+#define AES128OCB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "aes128e.h"
+#include "aes128d.h"
+
+/* Expanded OCB key: the AES encryption and decryption key schedules (sliced as well for the bitsliced
+   backend) and the whole L table, computed by aes128ocb_expand_key() and reused by every message under the
+   key. It is only read afterwards, so it may be shared by any number of threads. */
+typedef struct {
+    aes128_key ks;
+    aes128_dkey dk;
+    aes128_sliced_key sks;
+    aes128_sliced_key sdk;
+    unsigned char l_star[16];
+    unsigned char l_dollar[16];
+    unsigned char ls[64][16];
+    unsigned int nls;
+} aes128ocb_key;
+
+/* Memo of the nonce of the last message, for the nonces that are counters: 64 consecutive nonces share their
+   top (all but the last 6 bits) and so Ktop, the block cipher call of the nonce, which is only computed again
+   when the top changes. Owned by the caller, one per sequence of messages (e.g. per thread), so that the
+   expanded key stays read-only; it may be used with any key, as it records which key its Ktop is for. Must be
+   cleared with aes128ocb_nonce_clear() before its first use, and should be when it is no longer needed,
+   since Ktop is derived from the key. */
+typedef struct {
+    unsigned char l_star[16];
+    unsigned char top[16];
+    uint64_t stretch[3];
+    int valid;
+} aes128ocb_nonce;
+
+/* Most threads aes128ocb_parallel() and aes128ocb_parallel_ks() split a message across; larger thread counts
+   are reduced to it */
+#define AES128OCB_MAX_THREADS 64
+
+/* Thread pool of the caller for aes128ocb_parallel_ks(): run(ctx, task, arg, n) calls task(arg, i) for every i
+   from 0 to n-1, in any order and on any threads, and returns once they have all returned. */
+typedef struct {
+    void (*run)(void *ctx, void (*task)(void *arg, int i), void *arg, int n);
+    void *ctx;
+} aes128ocb_pool;
+
+/* One message of aes128ocb_batch(): the plen bytes at p with the alen bytes of associated data at a under the
+   12-byte nonce at n. The ciphertext and the tag are stored at c (plen+16 bytes); c may equal p. */
+typedef struct {
+    unsigned char *c;
+    const unsigned char *n;
+    const unsigned char *a;
+    size_t alen;
+    const unsigned char *p;
+    size_t plen;
+} aes128ocb_job;
+
+/* State of an OCB encryption that is fed in pieces: aes128ocb_init(), then aes128ocb_ad() and aes128ocb_update()
+   any number of times with chunks of any size, then aes128ocb_final(). Its size does not depend on the message length. */
+typedef struct {
+    aes128ocb_key own;
+    const aes128ocb_key *key;
+    unsigned char offset[16];
+    unsigned char checksum[16];
+    uint64_t blocks;
+    unsigned char buf[16];
+    size_t buflen;
+    unsigned char offsetA[16];
+    unsigned char sum[16];
+    uint64_t ablocks;
+    unsigned char abuf[16];
+    size_t abuflen;
+} aes128ocb_ctx;
+
+/* Expand the 16-byte (128-bit) key at k into key. */
+void aes128ocb_expand_key(aes128ocb_key *key, const unsigned char *k);
+
+/* Clear the key material at key. */
+void aes128ocb_wipe_key(aes128ocb_key *key);
+
 /* Under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n, encrypt the plaintext at p and store it at c. 
    The length of the plaintext is a multiple of 16 bytes given at len (e.g., len = 2 for a 32-byte p). The length of the
    ciphertext c is (len+1)*16 bytes. */
-void aes128ocb(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *p, const unsigned int len);
+void aes128ocb(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *p, const size_t len);
+
+/* Under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n, authenticate the alen bytes of associated
+   data at a, encrypt the plen bytes of plaintext at p and store the ciphertext at c followed by the 16-byte tag (plen+16
+   bytes). Any of the lengths may be zero and need not be a multiple of 16 (RFC 7253). c may equal p. */
+void aes128ocb_encrypt(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *a, size_t alen,
+                       const unsigned char *p, size_t plen);
+
+/* Clear the nonce memo at ns. */
+void aes128ocb_nonce_clear(aes128ocb_nonce *ns);
+
+/* Same as aes128ocb_encrypt() and aes128ocb_decrypt(), under the key expanded at key. ns is the nonce memo of the
+   caller, or NULL to compute Ktop for every message. */
+void aes128ocb_encrypt_ks(unsigned char *c, const aes128ocb_key *key, aes128ocb_nonce *ns, const unsigned char *n,
+                          const unsigned char *a, size_t alen, const unsigned char *p, size_t plen);
+int aes128ocb_decrypt_ks(unsigned char *p, const aes128ocb_key *key, aes128ocb_nonce *ns, const unsigned char *n,
+                         const unsigned char *a, size_t alen, const unsigned char *c, size_t clen);
+
+/* Under the key expanded at key and the 12-byte (96-bit) nonce at n, encrypt the message held in the n_in fragments of
+   in into the n_out fragments of out, which may be split at other places (or be the same list), and store the 16-byte
+   tag at tag. Returns 0, or -1 if out is shorter than in. */
+int aes128ocb_encryptv(const aes128ocb_key *key, const unsigned char *n, const struct iovec *in, int n_in, struct iovec *out,
+                       int n_out, unsigned char *tag);
+
+/* Encrypt the njobs independent messages of jobs under the key expanded at key, with blocks of different messages
+   encrypted together. The output of each job is the same as with aes128ocb_encrypt_ks(). */
+void aes128ocb_batch(const aes128ocb_key *key, const aes128ocb_job *jobs, size_t njobs);
+
+/* Same as aes128ocb_encrypt(), with the plaintext split across nthreads threads (one per online processor if
+   nthreads <= 0, at most AES128OCB_MAX_THREADS) started for the call. The output is the same as with
+   aes128ocb_encrypt(). Messages shorter than 4096 blocks per thread use fewer threads. c may equal p. */
+void aes128ocb_parallel(unsigned char *c, const unsigned char *k, const unsigned char *n, const unsigned char *a, size_t alen,
+                        const unsigned char *p, size_t plen, int nthreads);
+
+/* Same as aes128ocb_parallel(), under the key expanded at key, with the slices run by pool if it is not NULL
+   instead of threads started for the call. */
+void aes128ocb_parallel_ks(unsigned char *c, const aes128ocb_key *key, const unsigned char *n, const unsigned char *a,
+                           size_t alen, const unsigned char *p, size_t plen, int nthreads, const aes128ocb_pool *pool);
+
+/* Under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n, check the clen bytes at c (ciphertext followed
+   by the 16-byte tag) against the alen bytes of associated data at a, and decrypt the ciphertext at p (clen-16 bytes).
+   Returns 0 if the tag is valid and -1 otherwise; on failure p is cleared. p may equal c. */
+int aes128ocb_decrypt(unsigned char *p, const unsigned char *k, const unsigned char *n, const unsigned char *a, size_t alen,
+                      const unsigned char *c, size_t clen);
+
+/* Start the encryption of a message under the 16-byte (128-bit) key at k and the 12-byte (96-bit) nonce at n. */
+void aes128ocb_init(aes128ocb_ctx *ctx, const unsigned char *k, const unsigned char *n);
+
+/* Start the encryption of a message under the expanded key at key, which must be kept until aes128ocb_final(), with
+   the nonce memo at ns (or NULL). */
+void aes128ocb_init_ks(aes128ocb_ctx *ctx, const aes128ocb_key *key, aes128ocb_nonce *ns, const unsigned char *n);
+
+/* Add the next alen bytes of associated data at a. May be called any number of times before aes128ocb_final(),
+   in any order with aes128ocb_update(). */
+void aes128ocb_ad(aes128ocb_ctx *ctx, const unsigned char *a, size_t alen);
+
+/* Encrypt the next inlen bytes of the message at in. The complete blocks are written at out and their number
+   of bytes is returned; the remaining bytes (less than 16) are kept in ctx until the next call. out must have
+   room for inlen + 15 bytes. out may equal in as long as no bytes are kept from the previous call. */
+size_t aes128ocb_update(aes128ocb_ctx *ctx, const unsigned char *in, size_t inlen, unsigned char *out);
+
+/* Finish the message: the bytes kept from the last update (less than 16) are encrypted and written at out,
+   and the 16-byte tag is stored at t. Returns the number of bytes written at out. */
+size_t aes128ocb_final(aes128ocb_ctx *ctx, unsigned char *out, unsigned char *t);
 
+#endif
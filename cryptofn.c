@@ -0,0 +1,403 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "aes128common.h"
+#include "aes128ocb.h"
+#include "cryptofn_bench.h"
+#include "cryptofn_selftest.h"
+#include "cryptofn_stats.h"
+#include "groestl256.h"
+
+/* Command-line front end of the library:
+
+       cryptofn hash [-q] [FILE]
+       cryptofn ocb-encrypt [-q] (-k KEYHEX | -K KEYFILE) -n NONCEHEX [-a ADHEX] [-o OUTFILE] [FILE]
+       cryptofn bench [-j] [-f FUNCTION] [-s MAXBYTES] [-i ITERATIONS] [-T SECONDS] [-t MAXTHREADS]
+       cryptofn selftest [-v] [-n ROUNDS] [-s SEED]
+
+   hash prints the Grøstl-256 hash of FILE (standard input if absent or "-") in hex. ocb-encrypt writes the
+   AES-128-OCB ciphertext of FILE followed by the 16-byte tag, as aes128ocb_encrypt() does, to OUTFILE or the
+   standard output; the key is given in hex with -k or as a KEYFILE of exactly 16 raw bytes with -K. Regular files are mapped with mmap(); pipes and other streams are read by a second thread
+   into two alternating buffers, so that reading overlaps hashing or encryption. Unless -q is given, the number
+   of bytes and the throughput in MB/s are reported on the standard error, followed in a CRYPTOFN_STATS build
+   by the counters of every phase that ran (see cryptofn_stats.h). bench and selftest are
+   described in cryptofn_bench.c and cryptofn_selftest.c.
+
+   Built from all the .c files of this directory, e.g. cc -O2 -o cryptofn *.c -lpthread */
+
+/* Size of each buffer of the pipe reader, and of the pieces a mapped file is encrypted in */
+#define CHUNK (1 << 20)
+
+/* Input being processed: a mapped file, or a stream read by readerThread() */
+struct input {
+    int fd;
+    unsigned char *map;
+    size_t maplen;
+    size_t mapoff;
+
+    /* Double buffering of streams: the reader fills one buffer while the caller uses the other, held */
+    pthread_t reader;
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    unsigned char *buf[2];
+    size_t len[2];
+    int full[2];
+    int err;
+    int held;
+    int next;
+};
+
+/* Key material of ocb-encrypt: the key and the context that holds its expansion. wipeSecrets() is registered
+   with atexit(), so they are cleared on the error paths of fail() and usage() as well */
+static struct {
+    unsigned char k[16];
+    aes128ocb_ctx ctx;
+} secrets;
+
+/* Clears secrets */
+static void wipeSecrets(void) {
+
+    wipe(&secrets, 0, sizeof secrets);
+}
+
+/* Prints the usage and exits with status 2 */
+static void usage(void) {
+
+    fprintf(stderr,
+            "usage: cryptofn hash [-q] [FILE]\n"
+            "       cryptofn ocb-encrypt [-q] (-k KEYHEX | -K KEYFILE) -n NONCEHEX [-a ADHEX] [-o OUTFILE] [FILE]\n"
+            "       cryptofn bench [-j] [-f FUNCTION] [-s MAXBYTES] [-i ITERATIONS] [-T SECONDS] [-t MAXTHREADS]\n"
+            "       cryptofn selftest [-v] [-n ROUNDS] [-s SEED]\n");
+    exit(2);
+}
+
+/* Prints the message msg with the error errnum and exits with status 1 */
+static void fail(const char *msg, int errnum) {
+
+    if (errnum != 0) fprintf(stderr, "cryptofn: %s: %s\n", msg, strerror(errnum));
+    else fprintf(stderr, "cryptofn: %s\n", msg);
+    exit(1);
+}
+
+/* Seconds of the monotonic clock */
+static double now(void) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+/* Decodes the hex string s into exactly len bytes at out. Returns 0, or -1 if s is not 2*len hex digits */
+static int fromHex(unsigned char *out, const char *s, size_t len) {
+
+    size_t i;
+    if (strlen(s) != 2*len) return -1;
+    for (i = 0; i < 2*len; ++i) {
+        int c = s[i];
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (v < 0) return -1;
+        if (i%2 == 0) out[i/2] = (unsigned char)(v << 4);
+        else out[i/2] |= (unsigned char)v;
+    }
+    return 0;
+}
+
+/* Reads the key file at path into the 16 bytes at k. The file must hold exactly 16 bytes, so that a key written
+   in hex (32 digits, as -k takes it) is not taken as 16 characters. It is read with read() rather than stdio,
+   which would leave a copy of the key in the buffer of the stream */
+static void readKeyFile(const char *path, unsigned char *k) {
+
+    unsigned char buf[17];
+    size_t got = 0;
+    int err = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) fail(path, errno);
+
+    while (got < sizeof buf) {
+        ssize_t r = read(fd, buf + got, sizeof buf - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) err = errno;
+        if (r <= 0) break;
+        got += (size_t)r;
+    }
+    close(fd);
+
+    if (err == 0 && got == 16) memcpy(k, buf, 16);
+    wipe(buf, 0, sizeof buf);
+    if (err != 0) fail(path, err);
+    if (got != 16) fail("the key file must hold exactly 16 bytes (a key in hex goes with -k)", 0);
+}
+
+/* Writes the len bytes at p to fd, retrying after short writes */
+static void writeAll(int fd, const unsigned char *p, size_t len) {
+
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) fail("write", errno);
+        p += w;
+        len -= (size_t)w;
+    }
+}
+
+/* Reads from fd into alternating buffers until the end of the stream or an error */
+static void *readerThread(void *arg) {
+
+    struct input *in = arg;
+    int i = 0;
+    for (;;) {
+        pthread_mutex_lock(&in->mu);
+        while (in->full[i]) pthread_cond_wait(&in->cv, &in->mu);
+        pthread_mutex_unlock(&in->mu);
+
+        /* Fill the buffer completely unless the stream ends */
+        size_t len = 0;
+        int err = 0;
+        while (len < CHUNK) {
+            ssize_t r = read(in->fd, in->buf[i] + len, CHUNK - len);
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) err = errno;
+            if (r <= 0) break;
+            len += (size_t)r;
+        }
+
+        pthread_mutex_lock(&in->mu);
+        in->len[i] = len;
+        in->full[i] = 1;
+        in->err = err;
+        pthread_cond_broadcast(&in->cv);
+        pthread_mutex_unlock(&in->mu);
+
+        /* The end of the stream is passed on as an empty buffer */
+        if (len == 0) return NULL;
+        i = 1 - i;
+    }
+}
+
+/* Opens the input named path ("-" or NULL for the standard input): mapped if it is a regular file, read by
+   readerThread() otherwise */
+static void openInput(struct input *in, const char *path) {
+
+    memset(in, 0, sizeof *in);
+    in->held = -1;
+    in->fd = path == NULL || strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (in->fd < 0) fail(path, errno);
+
+    struct stat st;
+    if (fstat(in->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        in->maplen = (size_t)st.st_size;
+        if (in->maplen == 0) return;
+        in->map = mmap(NULL, in->maplen, PROT_READ, MAP_PRIVATE, in->fd, 0);
+        if (in->map != MAP_FAILED) {
+            madvise(in->map, in->maplen, MADV_SEQUENTIAL);
+            return;
+        }
+        in->map = NULL;
+        in->maplen = 0;
+    }
+
+    in->buf[0] = malloc(CHUNK);
+    in->buf[1] = malloc(CHUNK);
+    if (in->buf[0] == NULL || in->buf[1] == NULL) fail("out of memory", 0);
+    pthread_mutex_init(&in->mu, NULL);
+    pthread_cond_init(&in->cv, NULL);
+    if (pthread_create(&in->reader, NULL, readerThread, in) != 0) fail("cannot start the reader thread", 0);
+}
+
+/* Returns the next piece of the input at *p and its length, 0 at the end. The piece is valid until the next
+   call. A mapped file is returned in pieces of CHUNK bytes */
+static size_t nextInput(struct input *in, const unsigned char **p) {
+
+    if (in->buf[0] == NULL) {
+        size_t len = in->maplen - in->mapoff;
+        if (len > CHUNK) len = CHUNK;
+        *p = in->map + in->mapoff;
+        in->mapoff += len;
+        return len;
+    }
+
+    /* Hand the buffer used by the previous call back to the reader, then wait for the next one */
+    int i = in->next;
+    pthread_mutex_lock(&in->mu);
+    if (in->held >= 0) {
+        in->full[in->held] = 0;
+        pthread_cond_broadcast(&in->cv);
+    }
+    while (!in->full[i]) pthread_cond_wait(&in->cv, &in->mu);
+    size_t len = in->len[i];
+    int err = in->err;
+    pthread_mutex_unlock(&in->mu);
+
+    if (len == 0 && err != 0) fail("read", err);
+    in->held = i;
+    in->next = 1 - i;
+    *p = in->buf[i];
+    return len;
+}
+
+/* Releases the input */
+static void closeInput(struct input *in) {
+
+    if (in->buf[0] != NULL) {
+        pthread_join(in->reader, NULL);
+        if (in->err != 0) fail("read", in->err);
+        free(in->buf[0]);
+        free(in->buf[1]);
+    }
+    if (in->map != NULL) munmap(in->map, in->maplen);
+    if (in->fd != STDIN_FILENO) close(in->fd);
+}
+
+/* Reports the throughput of an operation on len bytes that took the given number of seconds */
+static void report(const char *what, unsigned long long len, double seconds) {
+
+    fprintf(stderr, "cryptofn: %s %llu bytes in %.3f s (%.1f MB/s)\n", what, len, seconds,
+            seconds > 0 ? len/seconds/1e6 : 0.0);
+
+    cryptofn_stats s;
+    cryptofn_stats_snapshot(&s);
+    int i;
+    for (i = 0; i < CRYPTOFN_STATS_NUM_PHASES; ++i) {
+        const cryptofn_stat *p = &s.phase[i];
+        if (p->calls == 0) continue;
+        fprintf(stderr, "cryptofn: %-16s %10llu calls %14llu %s %14llu bytes %12llu items (max %llu)\n",
+                cryptofn_stats_phase_name(i), p->calls, p->ticks, s.clock, p->bytes, p->items, p->max_items);
+    }
+}
+
+/* cryptofn hash */
+static int cmdHash(int argc, char **argv) {
+
+    int quiet = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "q")) != -1) {
+        if (opt == 'q') quiet = 1;
+        else usage();
+    }
+    if (argc - optind > 1) usage();
+
+    struct input in;
+    groestl256_ctx ctx;
+    unsigned char h[32];
+    const unsigned char *p;
+    size_t len;
+    unsigned long long total = 0;
+
+    double t = now();
+    openInput(&in, optind < argc ? argv[optind] : NULL);
+    groestl256_init(&ctx);
+    while ((len = nextInput(&in, &p)) > 0) {
+        groestl256_update(&ctx, p, len);
+        total += len;
+    }
+    groestl256_final(&ctx, h);
+    closeInput(&in);
+    t = now() - t;
+
+    int i;
+    for (i = 0; i < 32; ++i) {
+        printf("%02x", h[i]);
+    }
+    printf("  %s\n", optind < argc ? argv[optind] : "-");
+    if (!quiet) report("hashed", total, t);
+    return 0;
+}
+
+/* cryptofn ocb-encrypt */
+static int cmdEncrypt(int argc, char **argv) {
+
+    unsigned char *k = secrets.k;
+    unsigned char n[12];
+    unsigned char *a = NULL;
+    size_t alen = 0;
+    int haveKey = 0, haveNonce = 0, quiet = 0;
+    const char *outPath = NULL;
+    int opt;
+
+    atexit(wipeSecrets);
+    while ((opt = getopt(argc, argv, "k:K:n:a:o:q")) != -1) {
+        switch (opt) {
+        case 'k':
+            if (fromHex(k, optarg, 16) != 0) fail("the key must be 32 hex digits", 0);
+            haveKey = 1;
+            break;
+        case 'K':
+            readKeyFile(optarg, k);
+            haveKey = 1;
+            break;
+        case 'n':
+            if (fromHex(n, optarg, 12) != 0) fail("the nonce must be 24 hex digits", 0);
+            haveNonce = 1;
+            break;
+        case 'a':
+            alen = strlen(optarg)/2;
+            a = malloc(alen + 1);
+            if (a == NULL || fromHex(a, optarg, alen) != 0) fail("the associated data must be hex digits", 0);
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (!haveKey || !haveNonce || argc - optind > 1) usage();
+
+    int out = STDOUT_FILENO;
+    if (outPath != NULL) {
+        out = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0) fail(outPath, errno);
+    }
+
+    struct input in;
+    aes128ocb_ctx *ctx = &secrets.ctx;
+    unsigned char *buf = malloc(CHUNK + 16);
+    unsigned char tag[16];
+    const unsigned char *p;
+    size_t len;
+    unsigned long long total = 0;
+    if (buf == NULL) fail("out of memory", 0);
+
+    double t = now();
+    openInput(&in, optind < argc ? argv[optind] : NULL);
+    aes128ocb_init(ctx, k, n);
+    if (alen > 0) aes128ocb_ad(ctx, a, alen);
+    while ((len = nextInput(&in, &p)) > 0) {
+        writeAll(out, buf, aes128ocb_update(ctx, p, len, buf));
+        total += len;
+    }
+    writeAll(out, buf, aes128ocb_final(ctx, buf, tag));
+    writeAll(out, tag, 16);
+    closeInput(&in);
+    t = now() - t;
+
+    if (out != STDOUT_FILENO && close(out) != 0) fail(outPath, errno);
+    wipeSecrets();
+    free(buf);
+    free(a);
+    if (!quiet) report("encrypted", total, t);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+
+    if (argc < 2) usage();
+    if (strcmp(argv[1], "hash") == 0) return cmdHash(argc - 1, argv + 1);
+    if (strcmp(argv[1], "ocb-encrypt") == 0) return cmdEncrypt(argc - 1, argv + 1);
+    if (strcmp(argv[1], "bench") == 0) return cryptofn_bench(argc - 1, argv + 1);
+    if (strcmp(argv[1], "selftest") == 0) return cryptofn_selftest(argc - 1, argv + 1);
+    usage();
+    return 2;
+}
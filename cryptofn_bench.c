@@ -0,0 +1,413 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "aes128ctr.h"
+#include "aes128e.h"
+#include "aes128ocb.h"
+#include "cryptofn_bench.h"
+#include "groestl256.h"
+
+/* The time stamp counter is read on x86 with GCC or Clang (with SSE2 for LFENCE); elsewhere only nanoseconds are
+   reported */
+#if (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))) && defined(__GNUC__)
+#define BENCH_RDTSC
+#include <x86intrin.h>
+#endif
+
+/* Benchmarks of the public functions:
+
+       cryptofn bench [-j] [-f FUNCTION] [-s MAXBYTES] [-i ITERATIONS] [-T SECONDS] [-t MAXTHREADS]
+
+   Every function runs on messages of 16 bytes to MAXBYTES (64 MiB by default) in steps of four, under each
+   backend available on the CPU; the single-block aes128e() only on 16 bytes. For each case, the median and
+   99th percentile of the time per call are reported in nanoseconds, in cycles per byte (time stamp counter
+   cycles, which run at the nominal frequency, read with LFENCE and RDTSCP around the timed code) and as MB/s
+   at the median. Messages shorter than 4 KiB are timed in samples of several calls (4096/size of them, the
+   calls_per_sample column), divided by the number of calls, so that the clock reads do not dominate; the
+   cost of the clock reads themselves, measured at start, is subtracted from every sample. The 99th
+   percentile is left empty (null in JSON) for cases with fewer than 100 samples, where it would only be the
+   slowest one.
+   aes128ocb_parallel() and groestl256_tree() are then run on min(MAXBYTES, 16 MiB) with 1, 2, 4, ... up to
+   MAXTHREADS threads (the online processors by default).
+
+   The output is CSV, or JSON with -j, with one row per case. The build column lists the compile-time
+   variant flags that were defined, so that results of differently built binaries can be told apart.
+   Unless -i is given, each case runs for about SECONDS (0.5 by default), with at least 5 and at most 1000
+   samples; a size whose single call exceeds that budget is skipped, with the larger ones, for that backend. */
+
+/* Message sizes and thread counts */
+#define BENCH_MIN_SIZE 16
+#define BENCH_MAX_SIZE (64 << 20)
+#define BENCH_SWEEP_SIZE (16 << 20)
+#define BENCH_MIN_ITERS 5
+#define BENCH_MAX_ITERS 1000
+
+/* Fewest samples for which the 99th percentile is reported */
+#define BENCH_P99_ITERS 100
+
+/* Messages shorter than this are timed BENCH_BATCH_BYTES/size calls at a time */
+#define BENCH_BATCH_BYTES 4096
+
+/* Samples of the empty timed code that measure the cost of the clock reads */
+#define BENCH_CALIBRATE 1001
+
+/* Compile-time variant flags, as listed in the build column ("default" if none), each preceded by a space */
+static const char *buildFlags =
+#ifdef AES128E_REFERENCE
+    " AES128E_REFERENCE"
+#endif
+#ifdef AES128E_CONSTANT_TIME
+    " AES128E_CONSTANT_TIME"
+#endif
+#ifdef AES128E_NO_AESNI
+    " AES128E_NO_AESNI"
+#endif
+#ifdef GROESTL256_REFERENCE
+    " GROESTL256_REFERENCE"
+#endif
+#ifdef GROESTL256_NO_AESNI
+    " GROESTL256_NO_AESNI"
+#endif
+#ifdef CRYPTOFN_STATS
+    " CRYPTOFN_STATS"
+#endif
+    "";
+
+/* Options and buffers shared by the benchmarks */
+struct bench {
+    int json;
+    const char *only;
+    size_t maxSize;
+    int iters;
+    double budget;
+    int maxThreads;
+    int rows;
+    double baseNs;
+    double baseCyc;
+
+    unsigned char *in;
+    unsigned char *out;
+    unsigned char *out2;
+    unsigned char k[16];
+    unsigned char n[12];
+    aes128_key ks;
+    aes128ctr_ctx ctr;
+    int threads;
+};
+
+/* A function under test, called on size bytes of b->in */
+typedef void (*benchFn)(struct bench *b, size_t size);
+
+/* Nanoseconds of the monotonic clock */
+static double nowNs(void) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1e9 + t.tv_nsec;
+}
+
+/* Time stamp counter at the start of the timed code, or 0 where it is not read. The LFENCEs keep the
+   instructions before from finishing after the read, and those after from starting before it */
+static uint64_t cyclesStart(void) {
+
+#ifdef BENCH_RDTSC
+    _mm_lfence();
+    uint64_t c = __rdtsc();
+    _mm_lfence();
+    return c;
+#else
+    return 0;
+#endif
+}
+
+/* Time stamp counter at the end of the timed code: RDTSCP waits for the code before it to finish */
+static uint64_t cyclesStop(void) {
+
+#ifdef BENCH_RDTSC
+    unsigned int aux;
+    uint64_t c = __rdtscp(&aux);
+    _mm_lfence();
+    return c;
+#else
+    return 0;
+#endif
+}
+
+/* Comparison of doubles for qsort() */
+static int cmpDouble(const void *x, const void *y) {
+
+    double a = *(const double *)x, b = *(const double *)y;
+    return a < b ? -1 : a > b;
+}
+
+/* Value at the fraction q (0.5 for the median) of the sorted samples s[0..n-1] */
+static double quantile(const double *s, int n, double q) {
+
+    int i = (int)(q*(n - 1) + 0.5);
+    return s[i];
+}
+
+/* aes128e() on one block, including the key expansion */
+static void runAes(struct bench *b, size_t size) {
+    (void)size;
+    aes128e(b->out, b->in, b->k);
+}
+
+/* aes128e_blocks() on size/16 blocks */
+static void runBlocks(struct bench *b, size_t size) {
+    aes128e_blocks(b->out, b->in, size/16, &b->ks);
+}
+
+/* aes128ctr_xor() */
+static void runCtr(struct bench *b, size_t size) {
+    static const unsigned char iv[16] = { 0 };
+    aes128ctr_xor(&b->ctr, iv, b->in, b->out, size);
+}
+
+/* aes128ocb_encrypt(), including the key setup, without associated data */
+static void runOcbEncrypt(struct bench *b, size_t size) {
+    aes128ocb_encrypt(b->out, b->k, b->n, NULL, 0, b->in, size);
+}
+
+/* aes128ocb() on size/16 blocks, including the key setup */
+static void runOcb(struct bench *b, size_t size) {
+    aes128ocb(b->out, b->k, b->n, b->in, size/16);
+}
+
+/* aes128ocb_decrypt() of the ciphertext of b->in, which the caller prepares at b->out */
+static void runOcbDecrypt(struct bench *b, size_t size) {
+    aes128ocb_decrypt(b->out2, b->k, b->n, NULL, 0, b->out, size + 16);
+}
+
+/* groestl256() */
+static void runGroestl(struct bench *b, size_t size) {
+    groestl256(b->out, b->in, size);
+}
+
+/* aes128ocb_parallel() with b->threads threads */
+static void runOcbParallel(struct bench *b, size_t size) {
+    aes128ocb_parallel(b->out, b->k, b->n, NULL, 0, b->in, size, b->threads);
+}
+
+/* groestl256_tree() with the default leaf size and b->threads threads */
+static void runTree(struct bench *b, size_t size) {
+    groestl256_tree(b->out, b->in, size, 0, b->threads);
+}
+
+/* Prints one result row */
+static void emit(struct bench *b, const char *fn, const char *backend, size_t size, int threads, int iters,
+                 int batch, double medNs, double p99Ns, double medCyc, double p99Cyc) {
+
+    const char *build = buildFlags[0] != '\0' ? buildFlags + 1 : "default";
+    double mbps = medNs > 0 ? size/medNs*1e3 : 0;
+    double medCpb = medCyc/size;
+
+    /* The 99th percentile of too few samples is left out */
+    char p99NsText[32], p99CpbText[32];
+    if (iters >= BENCH_P99_ITERS) {
+        snprintf(p99NsText, sizeof p99NsText, "%.0f", p99Ns);
+        snprintf(p99CpbText, sizeof p99CpbText, "%.3f", p99Cyc/size);
+    }
+    else {
+        strcpy(p99NsText, b->json ? "null" : "");
+        strcpy(p99CpbText, b->json ? "null" : "");
+    }
+
+    if (!b->json) {
+        if (b->rows == 0) printf("function,backend,build,bytes,threads,iterations,calls_per_sample,median_ns,p99_ns,"
+                                 "median_cpb,p99_cpb,median_mbps\n");
+        printf("%s,%s,%s,%zu,%d,%d,%d,%.0f,%s,%.3f,%s,%.1f\n", fn, backend, build, size, threads, iters, batch,
+               medNs, p99NsText, medCpb, p99CpbText, mbps);
+    }
+    else {
+        printf("%s  {\"function\": \"%s\", \"backend\": \"%s\", \"build\": \"%s\", \"bytes\": %zu, \"threads\": %d, "
+               "\"iterations\": %d, \"calls_per_sample\": %d, \"median_ns\": %.0f, \"p99_ns\": %s, \"median_cpb\": %.3f, "
+               "\"p99_cpb\": %s, \"median_mbps\": %.1f}", b->rows == 0 ? "[\n" : ",\n", fn, backend, build, size, threads,
+               iters, batch, medNs, p99NsText, medCpb, p99CpbText, mbps);
+    }
+    ++b->rows;
+    fflush(stdout);
+}
+
+/* Times batch calls of fn on size bytes (none if fn is NULL), storing at ns and cyc the time and cycles per call
+   less the cost of the clock reads b->baseNs and b->baseCyc */
+static void sample(struct bench *b, benchFn run, size_t size, int batch, double *ns, double *cyc) {
+
+    int j;
+    double t0 = nowNs();
+    uint64_t c0 = cyclesStart();
+    for (j = 0; run != NULL && j < batch; ++j) {
+        run(b, size);
+    }
+    uint64_t c1 = cyclesStop();
+    double t1 = nowNs();
+
+    *ns = (t1 - t0 - b->baseNs)/batch;
+    *cyc = ((double)(c1 - c0) - b->baseCyc)/batch;
+    if (*ns < 0) *ns = 0;
+    if (*cyc < 0) *cyc = 0;
+}
+
+/* Measures the cost of the clock reads of sample(): the medians of samples of no call */
+static void calibrate(struct bench *b) {
+
+    static double ns[BENCH_CALIBRATE], cyc[BENCH_CALIBRATE];
+    int i;
+    for (i = 0; i < BENCH_CALIBRATE; ++i) {
+        sample(b, NULL, 0, 1, &ns[i], &cyc[i]);
+    }
+    qsort(ns, BENCH_CALIBRATE, sizeof *ns, cmpDouble);
+    qsort(cyc, BENCH_CALIBRATE, sizeof *cyc, cmpDouble);
+    b->baseNs = quantile(ns, BENCH_CALIBRATE, 0.5);
+    b->baseCyc = quantile(cyc, BENCH_CALIBRATE, 0.5);
+}
+
+/* Times fn on size bytes and prints its row. Returns -1 if a single call exceeds the time budget */
+static int measure(struct bench *b, const char *fn, benchFn run, const char *backend, size_t size, int threads) {
+
+    /* One untimed call warms the caches and sets the number of iterations */
+    double t = nowNs();
+    run(b, size);
+    t = nowNs() - t;
+
+    /* Short messages are timed several calls per sample */
+    int batch = size < BENCH_BATCH_BYTES ? (int)(BENCH_BATCH_BYTES/size) : 1;
+
+    int iters = b->iters;
+    if (iters <= 0) {
+        if (t > b->budget*1e9) return -1;
+        double fit = b->budget*1e9/(t*batch > 1 ? t*batch : 1);
+        iters = fit < BENCH_MIN_ITERS ? BENCH_MIN_ITERS : fit > BENCH_MAX_ITERS ? BENCH_MAX_ITERS : (int)fit;
+    }
+
+    double *ns = malloc(2*iters*sizeof *ns);
+    double *cyc = ns + iters;
+    if (ns == NULL) return -1;
+    int i;
+    for (i = 0; i < iters; ++i) {
+        sample(b, run, size, batch, &ns[i], &cyc[i]);
+    }
+    qsort(ns, iters, sizeof *ns, cmpDouble);
+    qsort(cyc, iters, sizeof *cyc, cmpDouble);
+
+    emit(b, fn, backend, size, threads, iters, batch, quantile(ns, iters, 0.5), quantile(ns, iters, 0.99),
+         quantile(cyc, iters, 0.5), quantile(cyc, iters, 0.99));
+    free(ns);
+    return 0;
+}
+
+/* Returns 1 if the function fn was selected with -f */
+static int selected(const struct bench *b, const char *fn) {
+    return b->only == NULL || strcmp(b->only, fn) == 0;
+}
+
+/* Runs fn over all sizes up to maxSize (and MAXBYTES) under every available AES backend (aes != 0) or Grøstl
+   backend */
+static void sizeSweep(struct bench *b, const char *fn, benchFn run, int aes, size_t maxSize) {
+
+    if (!selected(b, fn)) return;
+
+    int nb = aes ? AES128_NUM_BACKENDS : GROESTL256_NUM_BACKENDS;
+    int be;
+    for (be = 1; be < nb; ++be) {
+        if ((aes ? aes128_set_backend(be) : groestl256_set_backend(be)) != 0) continue;
+        const char *name = aes ? aes128_backend_name(be) : groestl256_backend_name(be);
+
+        /* Keys are expanded by the backend that uses them */
+        aes128_expand_key(&b->ks, b->k);
+        aes128ctr_init(&b->ctr, b->k);
+
+        size_t size;
+        for (size = BENCH_MIN_SIZE; size <= b->maxSize && size <= maxSize; size *= 4) {
+            if (run == runOcbDecrypt) aes128ocb_encrypt(b->out, b->k, b->n, NULL, 0, b->in, size);
+            if (measure(b, fn, run, name, size, 1) != 0) break;
+        }
+    }
+    aes128_set_backend(AES128_BACKEND_AUTO);
+    groestl256_set_backend(GROESTL256_BACKEND_AUTO);
+}
+
+/* Runs fn on one large message with 1, 2, 4, ... threads */
+static void threadSweep(struct bench *b, const char *fn, benchFn run, int aes) {
+
+    if (!selected(b, fn)) return;
+
+    size_t size = b->maxSize < BENCH_SWEEP_SIZE ? b->maxSize : BENCH_SWEEP_SIZE;
+    const char *name = aes ? aes128_backend_name(aes128_get_backend()) : groestl256_backend_name(groestl256_get_backend());
+    int t;
+    for (t = 1; ; t *= 2) {
+        if (t > b->maxThreads) t = b->maxThreads;
+        b->threads = t;
+        measure(b, fn, run, name, size, t);
+        if (t == b->maxThreads) break;
+    }
+}
+
+/* Run the benchmarks of "cryptofn bench". */
+int cryptofn_bench(int argc, char **argv) {
+
+    struct bench b;
+    memset(&b, 0, sizeof b);
+    b.maxSize = BENCH_MAX_SIZE;
+    b.budget = 0.5;
+
+    long np = sysconf(_SC_NPROCESSORS_ONLN);
+    b.maxThreads = np > 0 ? (int)np : 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "jf:s:i:T:t:")) != -1) {
+        switch (opt) {
+        case 'j': b.json = 1; break;
+        case 'f': b.only = optarg; break;
+        case 's': b.maxSize = strtoull(optarg, NULL, 0); break;
+        case 'i': b.iters = atoi(optarg); break;
+        case 'T': b.budget = atof(optarg); break;
+        case 't': b.maxThreads = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: cryptofn bench [-j] [-f FUNCTION] [-s MAXBYTES] [-i ITERATIONS] [-T SECONDS] "
+                            "[-t MAXTHREADS]\n");
+            return 2;
+        }
+    }
+    if (b.maxSize < BENCH_MIN_SIZE) b.maxSize = BENCH_MIN_SIZE;
+    if (b.maxThreads < 1) b.maxThreads = 1;
+
+    b.in = malloc(b.maxSize);
+    b.out = malloc(b.maxSize + 32);
+    b.out2 = malloc(b.maxSize + 32);
+    if (b.in == NULL || b.out == NULL || b.out2 == NULL) {
+        fprintf(stderr, "cryptofn: out of memory\n");
+        return 1;
+    }
+    size_t i;
+    for (i = 0; i < b.maxSize; ++i) {
+        b.in[i] = (unsigned char)(i*131 + 7);
+    }
+    for (i = 0; i < 16; ++i) {
+        b.k[i] = (unsigned char)i;
+    }
+    for (i = 0; i < 12; ++i) {
+        b.n[i] = (unsigned char)(0xa0 + i);
+    }
+
+    calibrate(&b);
+    sizeSweep(&b, "aes128e", runAes, 1, 16);
+    sizeSweep(&b, "aes128e_blocks", runBlocks, 1, BENCH_MAX_SIZE);
+    sizeSweep(&b, "aes128ctr_xor", runCtr, 1, BENCH_MAX_SIZE);
+    sizeSweep(&b, "aes128ocb", runOcb, 1, BENCH_MAX_SIZE);
+    sizeSweep(&b, "aes128ocb_encrypt", runOcbEncrypt, 1, BENCH_MAX_SIZE);
+    sizeSweep(&b, "aes128ocb_decrypt", runOcbDecrypt, 1, BENCH_MAX_SIZE);
+    sizeSweep(&b, "groestl256", runGroestl, 0, BENCH_MAX_SIZE);
+    threadSweep(&b, "aes128ocb_parallel", runOcbParallel, 1);
+    threadSweep(&b, "groestl256_tree", runTree, 0);
+    if (b.json) printf(b.rows > 0 ? "\n]\n" : "[]\n");
+
+    aes128ctr_wipe(&b.ctr);
+    free(b.in);
+    free(b.out);
+    free(b.out2);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef CRYPTOFN_BENCH_H
+#define CRYPTOFN_BENCH_H
+
+/* Run the benchmarks of "cryptofn bench" with its command-line arguments (argv[0] is "bench"). Returns the
+   exit status. */
+int cryptofn_bench(int argc, char **argv);
+
+#endif
@@ -0,0 +1,529 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "aes128cache.h"
+#include "aes128ctr.h"
+#include "aes128d.h"
+#include "aes128e.h"
+#include "aes128ocb.h"
+#include "cryptofn_selftest.h"
+#include "groestl256.h"
+
+/* Checks that every implementation compiled in and supported by the CPU gives the output of the reference code:
+
+       cryptofn selftest [-v] [-n ROUNDS] [-s SEED]
+
+   First the known-answer vectors of FIPS-197 (AES-128), RFC 7253 (OCB, including its iterated 128-bit tag
+   vector) and the Grøstl submission are checked under every backend. Then ROUNDS rounds (1000 by default) of
+   random keys, nonces, messages and lengths are fed to the reference backends (AES128_BACKEND_REF,
+   GROESTL256_BACKEND_REF) and to every other backend and API path (expanded keys, streaming, batches, threads,
+   scatter/gather, the key cache, counter mode, multi-buffer and tree hashing), and the results are compared.
+   Every 100th round, starting with the first, also encrypts a message long enough for 2 to 4 threads and a
+   batch of more than 64 messages with consecutive nonces. The Grøstl multi-buffer code is given more messages
+   than lanes, and the aesni-avx2 backend runs its AVX2 variant on CPUs with VAES. SEED (the time by default) is
+   printed so that a failure can be replayed. The exit status is 0 only if every check passed. */
+
+/* Longest random message, and the longest for the slow Grøstl reference backend */
+#define ST_MAX_LEN 1500
+#define ST_MAX_GROESTL 600
+
+/* Messages of groestl256_many(), more than its 4 lanes so that lanes are refilled */
+#define ST_MANY 11
+
+/* Rounds between the long (threaded and batched) OCB checks, and the block count of each thread there */
+#define ST_LARGE_EVERY 100
+#define ST_PAR_BLOCKS 4096
+
+/* Counts of the checks, and the state of the random generator */
+struct selftest {
+    int verbose;
+    unsigned long checks;
+    unsigned long failures;
+    uint64_t rng;
+};
+
+/* Records the result of a check, printing it if it failed or with -v */
+static void check(struct selftest *st, int ok, const char *what, const char *backend) {
+
+    ++st->checks;
+    if (!ok) ++st->failures;
+    if (!ok || st->verbose) printf("%s %s [%s]\n", ok ? "ok  " : "FAIL", what, backend);
+}
+
+/* Next 64 bits of the xorshift64* generator */
+static uint64_t rnd64(struct selftest *st) {
+
+    st->rng ^= st->rng >> 12;
+    st->rng ^= st->rng << 25;
+    st->rng ^= st->rng >> 27;
+    return st->rng*0x2545f4914f6cdd1dULL;
+}
+
+/* Fills the len bytes at p with random bytes */
+static void rndBytes(struct selftest *st, unsigned char *p, size_t len) {
+
+    size_t i;
+    for (i = 0; i < len; ++i) {
+        p[i] = (unsigned char)(rnd64(st) >> 56);
+    }
+}
+
+/* Random number in 0..n-1 */
+static size_t rndBelow(struct selftest *st, size_t n) {
+    return n > 0 ? (size_t)(rnd64(st)%n) : 0;
+}
+
+/* Decodes the hex string s into out and returns the number of bytes */
+static size_t hex(unsigned char *out, const char *s) {
+
+    size_t n = 0;
+    while (s[0] != '\0' && s[1] != '\0') {
+        unsigned int b;
+        sscanf(s, "%2x", &b);
+        out[n++] = (unsigned char)b;
+        s += 2;
+    }
+    return n;
+}
+
+/* The FIPS-197 vectors (appendices B and C.1) */
+static void katAes(struct selftest *st, const char *backend) {
+
+    static const char *vec[][3] = {
+        { "2b7e151628aed2a6abf7158809cf4f3c", "3243f6a8885a308d313198a2e0370734", "3925841d02dc09fbdc118597196a0b32" },
+        { "000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a" },
+    };
+    size_t i;
+    for (i = 0; i < sizeof vec/sizeof vec[0]; ++i) {
+        unsigned char k[16], p[16], c[16], out[16];
+        hex(k, vec[i][0]);
+        hex(p, vec[i][1]);
+        hex(c, vec[i][2]);
+        aes128e(out, p, k);
+        check(st, memcmp(out, c, 16) == 0, "FIPS-197 encryption", backend);
+        aes128d(out, c, k);
+        check(st, memcmp(out, p, 16) == 0, "FIPS-197 decryption", backend);
+    }
+}
+
+/* The RFC 7253 vectors with the key 000102...0f and a 128-bit tag, and its iterated vector */
+static void katOcb(struct selftest *st, const char *backend) {
+
+    static const char *vec[][4] = {
+        { "BBAA99887766554433221100", "", "", "785407BFFFC8AD9EDCC5520AC9111EE6" },
+        { "BBAA99887766554433221101", "0001020304050607", "0001020304050607",
+          "6820B3657B6F615A5725BDA0D3B4EB3A257C9AF1F8F03009" },
+        { "BBAA99887766554433221102", "0001020304050607", "", "81017F8203F081277152FADE694A0A00" },
+        { "BBAA99887766554433221103", "", "0001020304050607", "45DD69F8F5AAE72414054CD1F35D82760B2CD00D2F99BFA9" },
+        { "BBAA99887766554433221104", "000102030405060708090A0B0C0D0E0F", "000102030405060708090A0B0C0D0E0F",
+          "571D535B60B277188BE5147170A9A22C3AD7A4FF3835B8C5701C1CCEC8FC3358" },
+    };
+    unsigned char k[16], n[12], a[64], p[64], c[80], out[80];
+    size_t i;
+    for (i = 0; i < 16; ++i) {
+        k[i] = (unsigned char)i;
+    }
+    for (i = 0; i < sizeof vec/sizeof vec[0]; ++i) {
+        hex(n, vec[i][0]);
+        size_t alen = hex(a, vec[i][1]);
+        size_t plen = hex(p, vec[i][2]);
+        size_t clen = hex(c, vec[i][3]);
+        aes128ocb_encrypt(out, k, n, a, alen, p, plen);
+        check(st, memcmp(out, c, clen) == 0, "RFC 7253 encryption", backend);
+        check(st, aes128ocb_decrypt(out, k, n, a, alen, c, clen) == 0 && memcmp(out, p, plen) == 0,
+              "RFC 7253 decryption", backend);
+    }
+
+    /* Iterated vector of RFC 7253 appendix A for a 128-bit key and tag */
+    unsigned char *cc = malloc(128*(3*16 + 2*128));
+    unsigned char s[128], t[16], want[16];
+    size_t len = 0;
+    if (cc == NULL) return;
+    memset(k, 0, 16);
+    k[15] = 128;
+    memset(s, 0, sizeof s);
+    memset(n, 0, 12);
+    for (i = 0; i < 128; ++i) {
+        n[10] = (unsigned char)((3*i + 1) >> 8);
+        n[11] = (unsigned char)(3*i + 1);
+        aes128ocb_encrypt(cc + len, k, n, s, i, s, i);
+        len += i + 16;
+        n[10] = (unsigned char)((3*i + 2) >> 8);
+        n[11] = (unsigned char)(3*i + 2);
+        aes128ocb_encrypt(cc + len, k, n, NULL, 0, s, i);
+        len += i + 16;
+        n[10] = (unsigned char)((3*i + 3) >> 8);
+        n[11] = (unsigned char)(3*i + 3);
+        aes128ocb_encrypt(cc + len, k, n, s, i, NULL, 0);
+        len += 16;
+    }
+    n[10] = 385 >> 8;
+    n[11] = 385 & 0xff;
+    aes128ocb_encrypt(t, k, n, cc, len, NULL, 0);
+    hex(want, "67E944D23256C5E0B6C61FA22FDF1EA2");
+    check(st, memcmp(t, want, 16) == 0, "RFC 7253 iterated vector", backend);
+    free(cc);
+}
+
+/* Grøstl-256 vectors of the submission and of its published examples */
+static void katGroestl(struct selftest *st, const char *backend) {
+
+    static const char *vec[][2] = {
+        { "", "1a52d11d550039be16107f9c58db9ebcc417f16f736adb2502567119f0083467" },
+        { "The quick brown fox jumps over the lazy dog",
+          "8c7ad62eb26a21297bc39c2d7293b4bd4d3399fa8afab29e970471739e28b301" },
+        { "The quick brown fox jumps over the lazy dog.",
+          "f48290b1bcacee406a0429b993adb8fb3d065f4b09cbcdb464a631d4a0080aaf" },
+    };
+    size_t i;
+    for (i = 0; i < sizeof vec/sizeof vec[0]; ++i) {
+        unsigned char h[32], want[32];
+        hex(want, vec[i][1]);
+        groestl256(h, (const unsigned char *)vec[i][0], strlen(vec[i][0]));
+        check(st, memcmp(h, want, 32) == 0, "Grøstl-256 vector", backend);
+    }
+}
+
+/* Pool of aes128ocb_parallel_ks() that runs the tasks one after another on the calling thread, last first */
+static void reversePool(void *ctx, void (*task)(void *arg, int i), void *arg, int n) {
+
+    (void)ctx;
+    while (n-- > 0) {
+        task(arg, n);
+    }
+}
+
+/* One round of random AES and OCB inputs under the reference backend and under backend be */
+static void diffAes(struct selftest *st, int be) {
+
+    const char *name = aes128_backend_name(be);
+    unsigned char k[16], n[12], iv[16];
+    unsigned char a[ST_MAX_LEN], p[ST_MAX_LEN];
+    unsigned char want[ST_MAX_LEN + 16], want2[ST_MAX_LEN + 16], out[ST_MAX_LEN + 16], out2[ST_MAX_LEN + 16];
+    size_t alen = rndBelow(st, 100), plen = rndBelow(st, ST_MAX_LEN);
+    size_t nb = plen/16;
+
+    rndBytes(st, k, 16);
+    rndBytes(st, n, 12);
+    rndBytes(st, iv, 16);
+    rndBytes(st, a, alen);
+    rndBytes(st, p, plen);
+
+    /* Reference results */
+    aes128_set_backend(AES128_BACKEND_REF);
+    aes128_key ks;
+    aes128_expand_key(&ks, k);
+    unsigned char ecb[ST_MAX_LEN], ctr[ST_MAX_LEN];
+    aes128e_blocks(ecb, p, nb, &ks);
+    aes128ocb_encrypt(want, k, n, a, alen, p, plen);
+    aes128ocb_encrypt(want2, k, n, NULL, 0, p, 16*nb);
+
+    /* Counter mode built from single reference block encryptions */
+    unsigned char cb[16], blk[16];
+    size_t i, j;
+    memcpy(cb, iv, 16);
+    for (i = 0; i < plen; i += 16) {
+        aes128e_ks(blk, cb, &ks);
+        for (j = 0; j < 16 && i + j < plen; ++j) {
+            ctr[i + j] = p[i + j] ^ blk[j];
+        }
+        for (j = 16; j-- > 0 && ++cb[j] == 0; ) ;
+    }
+
+    if (aes128_set_backend(be) != 0) return;
+
+    aes128_expand_key(&ks, k);
+    aes128e_blocks(out, p, nb, &ks);
+    check(st, memcmp(out, ecb, 16*nb) == 0, "aes128e_blocks", name);
+
+    aes128_dkey dk;
+    aes128_expand_dkey(&dk, &ks);
+    aes128d_blocks(out2, out, nb, &dk);
+    check(st, memcmp(out2, p, 16*nb) == 0, "aes128d_blocks", name);
+
+    aes128ctr_ctx cctx;
+    aes128ctr_init(&cctx, k);
+    aes128ctr_xor(&cctx, iv, p, out, plen);
+    check(st, memcmp(out, ctr, plen) == 0, "aes128ctr_xor", name);
+    aes128ctr_wipe(&cctx);
+
+    aes128ocb_encrypt(out, k, n, a, alen, p, plen);
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_encrypt", name);
+    check(st, aes128ocb_decrypt(out2, k, n, a, alen, want, plen + 16) == 0 && memcmp(out2, p, plen) == 0,
+          "aes128ocb_decrypt", name);
+    if (plen > 0) {
+        out[rndBelow(st, plen + 16)] ^= (unsigned char)(1 + rndBelow(st, 255));
+        check(st, aes128ocb_decrypt(out2, k, n, a, alen, out, plen + 16) == -1, "aes128ocb_decrypt forgery", name);
+    }
+    aes128ocb(out, k, n, p, nb);
+    check(st, memcmp(out, want2, 16*nb + 16) == 0, "aes128ocb", name);
+
+    /* Expanded key, and in place */
+    aes128ocb_key key;
+    aes128ocb_expand_key(&key, k);
+    memcpy(out, p, plen);
+    aes128ocb_encrypt_ks(out, &key, NULL, n, a, alen, out, plen);
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_encrypt_ks in place", name);
+
+    /* Nonce memo: the next counter nonce reuses Ktop, and a memo of another key is not used */
+    aes128ocb_nonce ns;
+    aes128ocb_key key2;
+    unsigned char n2[12];
+    aes128ocb_nonce_clear(&ns);
+    aes128ocb_encrypt_ks(out, &key, &ns, n, a, alen, p, plen);
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_encrypt_ks nonce memo", name);
+    memcpy(n2, n, 12);
+    n2[11] ^= 1 + rndBelow(st, 63);
+    aes128ocb_encrypt_ks(out, &key, &ns, n2, a, alen, p, plen);
+    aes128ocb_encrypt_ks(out2, &key, NULL, n2, a, alen, p, plen);
+    check(st, memcmp(out, out2, plen + 16) == 0 && aes128ocb_decrypt_ks(out2, &key, &ns, n2, a, alen, out, plen + 16) == 0
+              && memcmp(out2, p, plen) == 0, "aes128ocb_encrypt_ks counter nonce", name);
+    aes128ocb_expand_key(&key2, iv);
+    aes128ocb_encrypt_ks(out, &key2, &ns, n2, a, alen, p, plen);
+    aes128ocb_encrypt_ks(out2, &key2, NULL, n2, a, alen, p, plen);
+    check(st, memcmp(out, out2, plen + 16) == 0, "aes128ocb_encrypt_ks nonce memo of another key", name);
+    aes128ocb_wipe_key(&key2);
+    aes128ocb_nonce_clear(&ns);
+
+    /* Streaming, in random pieces */
+    aes128ocb_ctx ctx;
+    size_t done = 0, outlen = 0;
+    aes128ocb_init(&ctx, k, n);
+    aes128ocb_ad(&ctx, a, alen);
+    while (done < plen) {
+        size_t piece = 1 + rndBelow(st, 100);
+        if (piece > plen - done) piece = plen - done;
+        outlen += aes128ocb_update(&ctx, p + done, piece, out + outlen);
+        done += piece;
+    }
+    outlen += aes128ocb_final(&ctx, out + outlen, out2);
+    memcpy(out + outlen, out2, 16);
+    check(st, outlen == plen && memcmp(out, want, plen + 16) == 0, "aes128ocb_update", name);
+
+    /* Threads */
+    aes128ocb_parallel(out, k, n, a, alen, p, plen, 1 + (int)rndBelow(st, 4));
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_parallel", name);
+
+    /* Batch of the same message twice */
+    aes128ocb_job jobs[2] = { { out, n, a, alen, p, plen }, { out2, n, a, alen, p, plen } };
+    aes128ocb_batch(&key, jobs, 2);
+    check(st, memcmp(out, want, plen + 16) == 0 && memcmp(out2, want, plen + 16) == 0, "aes128ocb_batch", name);
+
+    /* Threads of a pool of the caller */
+    aes128ocb_pool pool = { reversePool, NULL };
+    aes128ocb_parallel_ks(out, &key, n, a, alen, p, plen, 1 + (int)rndBelow(st, 4), &pool);
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_parallel_ks", name);
+
+    /* Scatter/gather, cut at random places */
+    struct iovec vin[3], vout[2];
+    size_t c1 = rndBelow(st, plen + 1), c2 = c1 + rndBelow(st, plen - c1 + 1), c3 = rndBelow(st, plen + 1);
+    vin[0].iov_base = p;
+    vin[0].iov_len = c1;
+    vin[1].iov_base = p + c1;
+    vin[1].iov_len = c2 - c1;
+    vin[2].iov_base = p + c2;
+    vin[2].iov_len = plen - c2;
+    vout[0].iov_base = out;
+    vout[0].iov_len = c3;
+    vout[1].iov_base = out + c3;
+    vout[1].iov_len = plen - c3;
+    int r = aes128ocb_encryptv(&key, n, vin, 3, vout, 2, out + plen);
+    check(st, r == 0 && (alen == 0 ? memcmp(out, want, plen + 16) == 0 : memcmp(out, want, plen) == 0),
+          "aes128ocb_encryptv", name);
+    aes128ocb_wipe_key(&key);
+
+    /* The key cache */
+    aes128_cache_enable(1);
+    aes128ocb_encrypt(out, k, n, a, alen, p, plen);
+    aes128ocb_encrypt(out2, k, n, a, alen, p, plen);
+    aes128_cache_enable(0);
+    aes128_cache_wipe();
+    check(st, memcmp(out, want, plen + 16) == 0 && memcmp(out2, want, plen + 16) == 0, "key cache", name);
+}
+
+/* Adds 1 to the 12-byte big-endian counter nonce at n */
+static void nextNonce(unsigned char *n) {
+
+    int j;
+    for (j = 12; j-- > 0 && ++n[j] == 0; ) ;
+}
+
+/* One round of long OCB inputs under the reference backend and under backend be: a message of 4 to 5 times
+   ST_PAR_BLOCKS blocks split across 2 to 4 threads, and a batch of 65 to 144 short messages with consecutive
+   nonces, so that the batch spans more than one group */
+static void diffOcbLarge(struct selftest *st, int be) {
+
+    const char *name = aes128_backend_name(be);
+    unsigned char k[16], n[12], a[100];
+    size_t alen = rndBelow(st, sizeof a), plen = 4*16*ST_PAR_BLOCKS + rndBelow(st, 16*ST_PAR_BLOCKS);
+    size_t njobs = 65 + rndBelow(st, 80), jlen = 1 + rndBelow(st, 200);
+    unsigned char *p = malloc(plen), *want = malloc(plen + 16), *out = malloc(plen + 16);
+    unsigned char *jn = malloc(12*njobs), *jwant = malloc((jlen + 16)*njobs), *jout = malloc((jlen + 16)*njobs);
+    aes128ocb_job *jobs = malloc(njobs*sizeof *jobs);
+    size_t i;
+
+    if (p == NULL || want == NULL || out == NULL || jn == NULL || jwant == NULL || jout == NULL || jobs == NULL) {
+        check(st, 0, "memory for the long OCB checks", name);
+        goto done;
+    }
+    rndBytes(st, k, 16);
+    rndBytes(st, n, 12);
+    rndBytes(st, a, alen);
+    rndBytes(st, p, plen);
+
+    /* Reference results; the jobs share the first jlen bytes of p and a, with the nonces n+1, n+2, ... */
+    aes128_set_backend(AES128_BACKEND_REF);
+    aes128ocb_encrypt(want, k, n, a, alen, p, plen);
+    memcpy(jn, n, 12);
+    for (i = 0; i < njobs; ++i) {
+        if (i > 0) memcpy(jn + 12*i, jn + 12*(i - 1), 12);
+        nextNonce(jn + 12*i);
+        aes128ocb_encrypt(jwant + (jlen + 16)*i, k, jn + 12*i, a, alen, p, jlen);
+    }
+
+    if (aes128_set_backend(be) != 0) goto done;
+
+    int threads = 2 + (int)rndBelow(st, 3);
+    aes128ocb_parallel(out, k, n, a, alen, p, plen, threads);
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_parallel long", name);
+
+    aes128ocb_key key;
+    aes128ocb_pool pool = { reversePool, NULL };
+    aes128ocb_expand_key(&key, k);
+    memcpy(out, p, plen);
+    aes128ocb_parallel_ks(out, &key, n, a, alen, out, plen, threads, NULL);
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_parallel_ks long in place", name);
+    aes128ocb_parallel_ks(out, &key, n, a, alen, p, plen, threads, &pool);
+    check(st, memcmp(out, want, plen + 16) == 0, "aes128ocb_parallel_ks long with a pool", name);
+
+    for (i = 0; i < njobs; ++i) {
+        aes128ocb_job job = { jout + (jlen + 16)*i, jn + 12*i, a, alen, p, jlen };
+        jobs[i] = job;
+    }
+    aes128ocb_batch(&key, jobs, njobs);
+    check(st, memcmp(jout, jwant, (jlen + 16)*njobs) == 0, "aes128ocb_batch consecutive nonces", name);
+    aes128ocb_wipe_key(&key);
+
+done:
+    free(p);
+    free(want);
+    free(out);
+    free(jn);
+    free(jwant);
+    free(jout);
+    free(jobs);
+}
+
+/* One round of random Grøstl-256 inputs under the reference backend and under backend be */
+static void diffGroestl(struct selftest *st, int be) {
+
+    const char *name = groestl256_backend_name(be);
+    unsigned char m[ST_MANY][ST_MAX_GROESTL];
+    unsigned char want[ST_MANY][32], h[ST_MANY][32];
+    size_t len[ST_MANY];
+    int i, count = 5 + (int)rndBelow(st, ST_MANY - 4);
+
+    groestl256_set_backend(GROESTL256_BACKEND_REF);
+    for (i = 0; i < count; ++i) {
+        len[i] = rndBelow(st, ST_MAX_GROESTL);
+        rndBytes(st, m[i], len[i]);
+        groestl256(want[i], m[i], len[i]);
+    }
+
+    if (groestl256_set_backend(be) != 0) return;
+
+    groestl256(h[0], m[0], len[0]);
+    check(st, memcmp(h[0], want[0], 32) == 0, "groestl256", name);
+
+    groestl256_ctx ctx;
+    size_t done = 0;
+    groestl256_init(&ctx);
+    while (done < len[1]) {
+        size_t piece = 1 + rndBelow(st, 130);
+        if (piece > len[1] - done) piece = len[1] - done;
+        groestl256_update(&ctx, m[1] + done, piece);
+        done += piece;
+    }
+    groestl256_final(&ctx, h[1]);
+    check(st, memcmp(h[1], want[1], 32) == 0, "groestl256_update", name);
+
+    /* More messages than lanes, of mixed lengths, so that lanes finish at different times and are refilled */
+    unsigned char *hp[ST_MANY];
+    const unsigned char *mp[ST_MANY];
+    for (i = 0; i < count; ++i) {
+        hp[i] = h[i];
+        mp[i] = m[i];
+    }
+    groestl256_many(hp, mp, len, (size_t)count);
+    check(st, memcmp(h, want, 32*(size_t)count) == 0, "groestl256_many", name);
+
+    /* A tree of one leaf is the plain hash; a bigger one must not depend on the thread count */
+    groestl256_tree(h[0], m[2], len[2], ST_MAX_GROESTL, 2);
+    check(st, memcmp(h[0], want[2], 32) == 0, "groestl256_tree one leaf", name);
+    groestl256_tree(h[0], m[3], len[3], 64, 1);
+    groestl256_set_backend(GROESTL256_BACKEND_REF);
+    groestl256_tree(h[1], m[3], len[3], 64, 3);
+    check(st, memcmp(h[0], h[1], 32) == 0, "groestl256_tree", name);
+}
+
+/* Run the known-answer and differential checks of "cryptofn selftest". */
+int cryptofn_selftest(int argc, char **argv) {
+
+    struct selftest st;
+    memset(&st, 0, sizeof st);
+    long rounds = 1000;
+    unsigned long long seed = (unsigned long long)time(NULL);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "vn:s:")) != -1) {
+        switch (opt) {
+        case 'v': st.verbose = 1; break;
+        case 'n': rounds = atol(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: cryptofn selftest [-v] [-n ROUNDS] [-s SEED]\n");
+            return 2;
+        }
+    }
+    st.rng = seed != 0 ? seed : 1;
+    printf("seed %llu\n", seed);
+
+    int be;
+    for (be = AES128_BACKEND_AUTO + 1; be < AES128_NUM_BACKENDS; ++be) {
+        if (aes128_set_backend(be) != 0) {
+            printf("skip %s (not available)\n", aes128_backend_name(be));
+            continue;
+        }
+        katAes(&st, aes128_backend_name(be));
+        katOcb(&st, aes128_backend_name(be));
+    }
+    for (be = GROESTL256_BACKEND_AUTO + 1; be < GROESTL256_NUM_BACKENDS; ++be) {
+        if (groestl256_set_backend(be) != 0) {
+            printf("skip %s (not available)\n", groestl256_backend_name(be));
+            continue;
+        }
+        katGroestl(&st, groestl256_backend_name(be));
+    }
+
+    /* Every round draws new inputs, compared under every backend including the reference one */
+    long r;
+    for (r = 0; r < rounds; ++r) {
+        for (be = AES128_BACKEND_AUTO + 1; be < AES128_NUM_BACKENDS; ++be) {
+            diffAes(&st, be);
+            if (r%ST_LARGE_EVERY == 0) diffOcbLarge(&st, be);
+        }
+        if (r%4 == 0) {
+            for (be = GROESTL256_BACKEND_AUTO + 1; be < GROESTL256_NUM_BACKENDS; ++be) {
+                diffGroestl(&st, be);
+            }
+        }
+    }
+    aes128_set_backend(AES128_BACKEND_AUTO);
+    groestl256_set_backend(GROESTL256_BACKEND_AUTO);
+
+    printf("%lu checks, %lu failed\n", st.checks, st.failures);
+    return st.failures != 0;
+}
@@ -0,0 +1,8 @@
+#ifndef CRYPTOFN_SELFTEST_H
+#define CRYPTOFN_SELFTEST_H
+
+/* Run the known-answer and differential checks of "cryptofn selftest" with its command-line arguments
+   (argv[0] is "selftest"). Returns 0 if every check passed, 1 otherwise. */
+int cryptofn_selftest(int argc, char **argv);
+
+#endif
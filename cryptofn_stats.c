@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cryptofn_stats.h"
+
+#ifdef CRYPTOFN_STATS_USDT
+#include <sys/sdt.h>
+#endif
+
+/* Phase counters of the library. Each thread adds to counters of its own, allocated at its first addition on
+   a cache line of their own, so that threads running the library at once (e.g. the workers of
+   aes128ocb_parallel()) neither lock nor share cache lines; only their owner writes them, and
+   cryptofn_stats_snapshot() adds up the counters of every thread, so a snapshot taken while other threads run
+   may mix counters of a call in progress. The counters of a thread that exits are merged into those of the
+   exited threads. cryptofn_stats_reset() starts a new generation: the counters of another generation count as
+   zero, and each thread clears its own at its next addition. The probe of a CRYPTOFN_STATS_USDT build,
+   cryptofn:phase, fires at each addition with the phase number, the ticks, the bytes and the items, e.g. for
+   perf probe sdt_cryptofn:phase or bpftrace -e 'usdt:./cryptofn:cryptofn:phase'. Without USDT support,
+   cryptofn_stats_add() can be traced with a uprobe. */
+
+static const char *const phaseNames[CRYPTOFN_STATS_NUM_PHASES] = {
+    "aes_key", "aes_blocks", "ocb_ltable", "ocb_nonce", "ocb_ad", "ocb_blocks", "ocb_tag", "ocb_batch",
+    "groestl_compress", "groestl_pad", "groestl_output", "groestl_many"
+};
+
+#ifdef CRYPTOFN_STATS
+
+#define STATS_LINE 64
+
+/* Counters of a thread, for generation gen, linked in the list of the counters of every thread */
+struct threadStats {
+    cryptofn_stat phase[CRYPTOFN_STATS_NUM_PHASES];
+    unsigned long gen;
+    struct threadStats *prev;
+    struct threadStats *next;
+} __attribute__((aligned(STATS_LINE)));
+
+/* Counters of the calling thread */
+static __thread struct threadStats *mine;
+
+/* The counters of every live thread, and those of the threads that exited (in generation exited.gen) */
+static struct threadStats *threads;
+static struct threadStats exited;
+static pthread_mutex_t threadsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Counters of the threads whose own could not be allocated, added to with atomics */
+static struct threadStats shared;
+
+/* Generation of the counters, advanced by cryptofn_stats_reset() */
+static unsigned long generation;
+
+/* Its destructor merges the counters of a thread into exited when the thread exits */
+static pthread_key_t exitKey;
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+
+/* Adds the counters at from to those at to, keeping the larger max_items */
+static void mergeStats(cryptofn_stat *to, const cryptofn_stat *from) {
+
+    int i;
+    for (i = 0; i < CRYPTOFN_STATS_NUM_PHASES; ++i) {
+        to[i].calls += __atomic_load_n(&from[i].calls, __ATOMIC_RELAXED);
+        to[i].ticks += __atomic_load_n(&from[i].ticks, __ATOMIC_RELAXED);
+        to[i].bytes += __atomic_load_n(&from[i].bytes, __ATOMIC_RELAXED);
+        to[i].items += __atomic_load_n(&from[i].items, __ATOMIC_RELAXED);
+        unsigned long long max = __atomic_load_n(&from[i].max_items, __ATOMIC_RELAXED);
+        if (max > to[i].max_items) to[i].max_items = max;
+    }
+}
+
+/* Removes the counters of an exiting thread from the list, merges them into exited and frees them */
+static void freeStats(void *arg) {
+
+    struct threadStats *t = arg;
+
+    pthread_mutex_lock(&threadsLock);
+    if (t->prev != NULL) t->prev->next = t->next;
+    else threads = t->next;
+    if (t->next != NULL) t->next->prev = t->prev;
+    if (t->gen == exited.gen) mergeStats(exited.phase, t->phase);
+    pthread_mutex_unlock(&threadsLock);
+
+    free(t);
+}
+
+/* Creates the key of the exit destructor */
+static void init(void) {
+
+    pthread_key_create(&exitKey, freeStats);
+}
+
+/* Returns the counters of the calling thread, allocating them and adding them to the list at the first call,
+   or NULL if they cannot be allocated */
+static struct threadStats *ownStats(void) {
+
+    if (mine != NULL) return mine;
+
+    pthread_once(&initOnce, init);
+    void *p;
+    if (posix_memalign(&p, STATS_LINE, sizeof(struct threadStats)) != 0) return NULL;
+    struct threadStats *t = memset(p, 0, sizeof *t);
+
+    pthread_mutex_lock(&threadsLock);
+    t->gen = generation;
+    t->next = threads;
+    if (threads != NULL) threads->prev = t;
+    threads = t;
+    pthread_mutex_unlock(&threadsLock);
+
+    pthread_setspecific(exitKey, t);
+    mine = t;
+    return t;
+}
+
+/* Adds one call of ticks, bytes and items to phase. */
+void cryptofn_stats_add(int phase, uint64_t ticks, uint64_t bytes, uint64_t items) {
+
+    struct threadStats *t = ownStats();
+
+    if (t != NULL) {
+        /* Only this thread writes its counters: plain additions, stored atomically for the snapshot */
+        unsigned long gen = __atomic_load_n(&generation, __ATOMIC_RELAXED);
+        if (t->gen != gen) {
+            int i;
+            for (i = 0; i < CRYPTOFN_STATS_NUM_PHASES; ++i) {
+                cryptofn_stat *c = &t->phase[i];
+                __atomic_store_n(&c->calls, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&c->ticks, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&c->bytes, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&c->items, 0, __ATOMIC_RELAXED);
+                __atomic_store_n(&c->max_items, 0, __ATOMIC_RELAXED);
+            }
+            __atomic_store_n(&t->gen, gen, __ATOMIC_RELEASE);
+        }
+        cryptofn_stat *c = &t->phase[phase];
+        __atomic_store_n(&c->calls, c->calls + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->ticks, c->ticks + ticks, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->bytes, c->bytes + bytes, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->items, c->items + items, __ATOMIC_RELAXED);
+        if (items > c->max_items) __atomic_store_n(&c->max_items, items, __ATOMIC_RELAXED);
+    }
+    else {
+        cryptofn_stat *c = &shared.phase[phase];
+        __atomic_fetch_add(&c->calls, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&c->ticks, ticks, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&c->bytes, bytes, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&c->items, items, __ATOMIC_RELAXED);
+
+        unsigned long long max = __atomic_load_n(&c->max_items, __ATOMIC_RELAXED);
+        while (items > max && !__atomic_compare_exchange_n(&c->max_items, &max, items, 1, __ATOMIC_RELAXED,
+                                                           __ATOMIC_RELAXED)) ;
+    }
+
+#ifdef CRYPTOFN_STATS_USDT
+    DTRACE_PROBE4(cryptofn, phase, phase, ticks, bytes, items);
+#endif
+}
+
+#endif
+
+/* Store at s the counters accumulated since the start or the last cryptofn_stats_reset(). */
+void cryptofn_stats_snapshot(cryptofn_stats *s) {
+
+    memset(s, 0, sizeof *s);
+#ifdef CRYPTOFN_STATS
+    s->enabled = 1;
+#ifdef CRYPTOFN_STATS_RDTSC
+    s->clock = "cycles";
+#else
+    s->clock = "ns";
+#endif
+    pthread_mutex_lock(&threadsLock);
+    unsigned long gen = generation;
+    struct threadStats *t;
+    for (t = threads; t != NULL; t = t->next) {
+        if (__atomic_load_n(&t->gen, __ATOMIC_ACQUIRE) == gen) mergeStats(s->phase, t->phase);
+    }
+    mergeStats(s->phase, exited.phase);
+    mergeStats(s->phase, shared.phase);
+    pthread_mutex_unlock(&threadsLock);
+#else
+    s->clock = "none";
+#endif
+}
+
+/* Set every counter to zero. */
+void cryptofn_stats_reset(void) {
+
+#ifdef CRYPTOFN_STATS
+    pthread_mutex_lock(&threadsLock);
+    __atomic_store_n(&generation, generation + 1, __ATOMIC_RELAXED);
+    memset(exited.phase, 0, sizeof exited.phase);
+    exited.gen = generation;
+    int i;
+    for (i = 0; i < CRYPTOFN_STATS_NUM_PHASES; ++i) {
+        __atomic_store_n(&shared.phase[i].calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&shared.phase[i].ticks, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&shared.phase[i].bytes, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&shared.phase[i].items, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&shared.phase[i].max_items, 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&threadsLock);
+#endif
+}
+
+/* Name of phase (e.g. "ocb_blocks"), or "unknown". */
+const char *cryptofn_stats_phase_name(int phase) {
+    if (phase < 0 || phase >= CRYPTOFN_STATS_NUM_PHASES) return "unknown";
+    return phaseNames[phase];
+}
@@ -0,0 +1,99 @@
+#ifndef CRYPTOFN_STATS_H
+#define CRYPTOFN_STATS_H
+
+#include <stdint.h>
+
+/* Optional counters of the time spent in each phase of the library, for builds with -DCRYPTOFN_STATS (or
+   -DCRYPTOFN_STATS_USDT, which also adds the USDT probe cryptofn:phase, see cryptofn_stats.c). Without the
+   flag the hooks in the code expand to nothing and cryptofn_stats_snapshot() returns zeros.
+
+   A phase counts the calls, the clock ticks (time stamp counter cycles on x86, nanoseconds elsewhere), the
+   bytes and the items (blocks, jobs or messages, i.e. the batch size) of every time it runs. Some phases run
+   inside others: CRYPTOFN_STAT_AES_BLOCKS also counts the blocks encrypted by OCB, and
+   CRYPTOFN_STAT_OCB_BATCH includes the key, nonce and tag work of its messages. Each thread keeps counters of
+   its own; a snapshot adds up those of every thread. */
+
+enum {
+    CRYPTOFN_STAT_AES_KEY = 0,          /* aes128_expand_key() and aes128_expand_dkey() */
+    CRYPTOFN_STAT_AES_BLOCKS,           /* aes128e_blocks(), items are blocks */
+    CRYPTOFN_STAT_OCB_LTABLE,           /* L table of OCB: l_star, l_dollar and each new l_i */
+    CRYPTOFN_STAT_OCB_NONCE,            /* Offset_0 from the nonce (Ktop and stretch) */
+    CRYPTOFN_STAT_OCB_AD,               /* Hash of the associated data, items are blocks */
+    CRYPTOFN_STAT_OCB_BLOCKS,           /* Encryption or decryption of the message blocks, items are blocks */
+    CRYPTOFN_STAT_OCB_TAG,              /* Finalization: the tag */
+    CRYPTOFN_STAT_OCB_BATCH,            /* aes128ocb_batch(), items are messages */
+    CRYPTOFN_STAT_GROESTL_COMPRESS,     /* Compression of the message blocks, items are blocks */
+    CRYPTOFN_STAT_GROESTL_PAD,          /* Padding and compression of the last one or two blocks */
+    CRYPTOFN_STAT_GROESTL_OUTPUT,       /* Output transformation */
+    CRYPTOFN_STAT_GROESTL_MANY,         /* groestl256_many(), items are messages */
+    CRYPTOFN_STATS_NUM_PHASES
+};
+
+/* Counters of one phase */
+typedef struct {
+    unsigned long long calls;
+    unsigned long long ticks;
+    unsigned long long bytes;
+    unsigned long long items;
+    unsigned long long max_items;
+} cryptofn_stat;
+
+/* Counters of every phase. enabled is 0 in a build without CRYPTOFN_STATS; clock is "cycles" or "ns". */
+typedef struct {
+    int enabled;
+    const char *clock;
+    cryptofn_stat phase[CRYPTOFN_STATS_NUM_PHASES];
+} cryptofn_stats;
+
+/* Store at s the counters accumulated since the start or the last cryptofn_stats_reset(). */
+void cryptofn_stats_snapshot(cryptofn_stats *s);
+
+/* Set every counter to zero. */
+void cryptofn_stats_reset(void);
+
+/* Name of phase (e.g. "ocb_blocks"), or "unknown". */
+const char *cryptofn_stats_phase_name(int phase);
+
+#ifdef CRYPTOFN_STATS_USDT
+#ifndef CRYPTOFN_STATS
+#define CRYPTOFN_STATS
+#endif
+#endif
+
+#ifdef CRYPTOFN_STATS
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CRYPTOFN_STATS_RDTSC
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/* Current tick of the clock of the counters */
+static inline uint64_t cryptofn_stats_ticks(void) {
+
+#ifdef CRYPTOFN_STATS_RDTSC
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec*1000000000u + (uint64_t)t.tv_nsec;
+#endif
+}
+
+/* Adds one call of ticks, bytes and items to phase; used through CRYPTOFN_STATS_STOP */
+void cryptofn_stats_add(int phase, uint64_t ticks, uint64_t bytes, uint64_t items);
+
+/* Start timing a phase in the variable t, then account it to phase with its bytes and items */
+#define CRYPTOFN_STATS_START(t) uint64_t t = cryptofn_stats_ticks()
+#define CRYPTOFN_STATS_STOP(t, phase, bytes, items) \
+    cryptofn_stats_add((phase), cryptofn_stats_ticks() - (t), (bytes), (items))
+
+#else
+
+#define CRYPTOFN_STATS_START(t)
+#define CRYPTOFN_STATS_STOP(t, phase, bytes, items) ((void)0)
+
+#endif
+
+#endif
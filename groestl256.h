@@ -1,3 +1,70 @@
+#ifndef GROESTL256_H
+#define GROESTL256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* State of an incremental hash: the chaining value (eight 64-bit columns, row 0 in the most significant byte),
+   the bytes of an incomplete block and the number of 64-byte blocks compressed so far. */
+typedef struct {
+    uint64_t h[8];
+    unsigned char buf[64];
+    size_t buflen;
+    uint64_t blocks;
+} groestl256_ctx;
+
+/* Implementations of the compression function. The fastest one supported by the CPU is chosen at first use;
+   the GROESTL256_BACKEND environment variable ("ref", "ttable", "aesni" or "aesni-avx2") or groestl256_set_backend()
+   force one. */
+enum {
+    GROESTL256_BACKEND_AUTO = 0,    /* AES-NI if the CPU supports it, the 64-bit implementation otherwise */
+    GROESTL256_BACKEND_REF,         /* Byte-matrix reference implementation */
+    GROESTL256_BACKEND_TTABLE,      /* 64-bit implementation with fused round tables */
+    GROESTL256_BACKEND_AESNI,       /* AESENCLAST for SubBytes, P and Q in one pass (x86 only) */
+    GROESTL256_BACKEND_AESNI_AVX2,  /* AES-NI with the multi-buffer code of AVX2 CPUs even if the CPU has VAES;
+                                       never chosen automatically, for tests and comparisons */
+    GROESTL256_NUM_BACKENDS
+};
+
+/* Force the backend b. Must not be called while other threads are hashing. Returns 0 on success
+   and -1 if b is not compiled in or not supported by the CPU. */
+int groestl256_set_backend(int b);
+
+/* Returns the GROESTL256_BACKEND_* constant of the backend in use. */
+int groestl256_get_backend(void);
+
+/* Returns the name of the backend b. */
+const char *groestl256_backend_name(int b);
+
 /* Hash the message at m and store the 32-byte hash at h. The length of m in bytes is given at n. */
 void groestl256(unsigned char *h, const unsigned char *m, unsigned long long n);
 
+/* Hash the count messages at msgs[i], of lens[i] bytes, and store their 32-byte hashes at hashes[i]. The hashes
+   are the same as with groestl256(); with the AES-NI backend on a CPU with AVX2, four messages are hashed at a
+   time, which pays off for many short messages. */
+void groestl256_many(unsigned char *const hashes[], const unsigned char *const msgs[], const size_t lens[],
+                     size_t count);
+
+/* Default leaf size of groestl256_tree() */
+#define GROESTL256_TREE_LEAF (1 << 20)
+
+/* Tree hash of the message at m of n bytes, stored at h (32 bytes). The message is cut into leaves of leafsize
+   bytes (GROESTL256_TREE_LEAF if 0), the last one possibly shorter, which are hashed with groestl256() by
+   nthreads threads (one per online processor if nthreads <= 0). Pairs of chaining values are then combined
+   level by level with the compression function. This is NOT the same hash as groestl256(), except for
+   messages of one leaf, and it depends on leafsize, but not on nthreads. Returns 0, or -1 if memory for the
+   leaf chaining values could not be allocated. */
+int groestl256_tree(unsigned char *h, const unsigned char *m, unsigned long long n, size_t leafsize, int nthreads);
+
+/* Start hashing a new message. */
+void groestl256_init(groestl256_ctx *ctx);
+
+/* Hash the len bytes at m as the continuation of the message. Full 64-byte blocks are compressed directly from m;
+   only an incomplete tail is kept in ctx. */
+void groestl256_update(groestl256_ctx *ctx, const unsigned char *m, size_t len);
+
+/* Pad the message, and store its 32-byte hash at h. ctx must be started again with groestl256_init() before
+   it is reused. */
+void groestl256_final(groestl256_ctx *ctx, unsigned char *h);
+
+#endif